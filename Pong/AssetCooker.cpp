@@ -0,0 +1,96 @@
+/**
+* Asset cooker. Decodes PNGs once, offline, into an asset pack the game
+* memory-maps at startup instead of decoding every launch.
+*
+* Usage: AssetCooker <out.pack> [--atlas <name>] <png>... [--images <png>...]
+*   --atlas   pack the PNGs that follow into one atlas entry called name
+*   --images  store the PNGs that follow as entries of their own
+*
+* The game looks for sprites/sprites.pack with an atlas called sprites;
+* from the Pong directory:
+*   AssetCooker sprites/sprites.pack --atlas sprites sprites/left_paddle.png
+*       sprites/right_paddle.png sprites/ball.png sprites/dotted_line.png
+*       sprites/player_1.png sprites/player_2.png
+*       --images sprites/p1_win.png sprites/p2_win.png
+**/
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "AssetPack.h"
+#include "AtlasPacker.h"
+#include "Logger.h"
+#include "stb_image.h"
+#include <string.h>
+
+static bool load_png(const char *path, AtlasImage &image)
+{
+    int number_of_components;
+    image.pixels = stbi_load(path, &image.width, &image.height, &number_of_components, STBI_rgb_alpha);
+    if (image.pixels == NULL) { LOG_ERROR("Unable to load image " << path); }
+    else if (strlen(path) >= ASSET_PACK_NAME_BYTES)
+    {
+        LOG_ERROR("Path too long for a pack entry: " << path);
+        return false;
+    }
+    return image.pixels != NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        LOG("Usage: AssetCooker <out.pack> [--atlas <name>] <png>... [--images <png>...]");
+        return 1;
+    }
+
+    AssetPackWriter writer;
+    std::string atlas_name;
+    std::vector<std::string> atlas_paths, image_paths;
+    bool into_atlas = false;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--atlas") == 0 and i + 1 < argc)
+        {
+            atlas_name = argv[++i];
+            into_atlas = true;
+        }
+        else if (strcmp(argv[i], "--images") == 0) { into_atlas = false; }
+        else if (into_atlas) { atlas_paths.push_back(argv[i]); }
+        else { image_paths.push_back(argv[i]); }
+    }
+
+    bool ok = true;
+    if (!atlas_paths.empty())
+    {
+        std::vector<AtlasImage> images(atlas_paths.size());
+        for (size_t i = 0; i < atlas_paths.size(); i++) { ok = load_png(atlas_paths[i].c_str(), images[i]) and ok; }
+        AtlasLayout layout;
+        if (ok and !pack_atlas(images, layout))
+        {
+            LOG_ERROR("Images do not fit in a " << ATLAS_MAX_SIZE << "x" << ATLAS_MAX_SIZE << " atlas");
+            ok = false;
+        }
+        if (ok)
+        {
+            writer.AddAtlas(atlas_name.c_str(), atlas_paths, layout);
+            LOG("Atlas " << atlas_name << ": " << atlas_paths.size() << " images in " << layout.width << "x"
+                << layout.height);
+        }
+        for (AtlasImage &image : images) { stbi_image_free((void*) image.pixels); }
+    }
+    for (const std::string &path : image_paths)
+    {
+        AtlasImage image = { 0, 0, NULL };
+        if (load_png(path.c_str(), image))
+        {
+            writer.AddImage(path.c_str(), image.width, image.height, image.pixels);
+            LOG("Image " << path << ": " << image.width << "x" << image.height);
+        }
+        else { ok = false; }
+        stbi_image_free((void*) image.pixels);
+    }
+
+    if (!ok or !writer.Write(argv[1])) { return 1; }
+    LOG("Wrote " << argv[1]);
+    return 0;
+}
@@ -0,0 +1,162 @@
+#include "AssetLoader.h"
+#include "AssetSource.h"
+#include "GameClock.h"
+#include "Tracer.h"
+#include "stb_image.h"
+#include <algorithm>
+
+bool decode_image(LoadedImage &image)
+{
+    TRACE_ZONE_DETAIL("load_image", image.path);
+    uint64_t start = clock_counter();
+    int number_of_components;
+    const EmbeddedAsset *asset = find_embedded_asset(image.path);
+    if (asset != NULL)
+    {
+        image.pixels = stbi_load_from_memory(asset->data, (int) asset->size, &image.width, &image.height,
+                                             &number_of_components, STBI_rgb_alpha);
+    }
+    else
+    {
+        image.pixels = stbi_load(asset_path(image.path).c_str(), &image.width, &image.height,
+                                 &number_of_components, STBI_rgb_alpha);
+    }
+    image.decode_seconds = (double) (clock_counter() - start) / clock_frequency();
+    return image.pixels != NULL;
+}
+
+void free_image(LoadedImage &image)
+{
+    if (image.pixels != NULL) { stbi_image_free(image.pixels); }
+    image.pixels = NULL;
+}
+
+AssetLoader::AssetLoader()
+    : wall_seconds(0.0), decode_seconds(0.0), slowest_seconds(0.0), threads(0), outstanding(0), start_counter(0)
+{
+}
+
+AssetLoader::~AssetLoader()
+{
+    Stop();
+}
+
+void AssetLoader::Queue(int id, const char *path)
+{
+    LoadedImage image = { id, path, 0, 0, NULL, 0.0 };
+    std::lock_guard<std::mutex> lock(mutex);
+    jobs.push_back(image);
+    outstanding++;
+}
+
+void AssetLoader::Start(int thread_count)
+{
+    if (thread_count <= 0) { thread_count = (int) std::thread::hardware_concurrency(); }
+    threads = std::min(std::max(thread_count, 1), ASSET_LOADER_MAX_THREADS);
+    threads = std::min(threads, std::max((int) jobs.size(), 1));
+    wall_seconds = decode_seconds = slowest_seconds = 0.0;
+    start_counter = clock_counter();
+    for (int i = 0; i < threads; i++) { workers.push_back(std::thread(&AssetLoader::WorkerLoop, this)); }
+}
+
+void AssetLoader::WorkerLoop()
+{
+#ifdef POKEPONG_TRACE
+    trace_set_thread_name("asset_loader");
+#endif
+    for (;;)
+    {
+        LoadedImage image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobs.empty()) { return; }
+            image = jobs.front();
+            jobs.pop_front();
+        }
+
+        decode_image(image);
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decode_seconds += image.decode_seconds;
+            slowest_seconds = std::max(slowest_seconds, image.decode_seconds);
+            wall_seconds = (double) (clock_counter() - start_counter) / clock_frequency();
+            finished.push_back(image);
+        }
+        done.notify_one();
+    }
+}
+
+bool AssetLoader::Next(LoadedImage &image)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    if (outstanding == 0) { return false; }
+    done.wait(lock, [this] { return !finished.empty(); });
+    image = finished.front();
+    finished.pop_front();
+    outstanding--;
+    return true;
+}
+
+void AssetLoader::Stop()
+{
+    {
+        // Nothing new gets picked up, images being decoded still finish
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.clear();
+    }
+    for (std::thread &worker : workers) { worker.join(); }
+    workers.clear();
+    for (LoadedImage &image : finished) { free_image(image); }
+    finished.clear();
+    outstanding = 0;
+}
+
+LazyImage::LazyImage() : wait_seconds(0.0), started(false)
+{
+    LoadedImage empty = { 0, NULL, 0, 0, NULL, 0.0 };
+    image = empty;
+}
+
+LazyImage::~LazyImage()
+{
+    if (decoder.joinable()) { decoder.join(); }
+    free_image(image);
+}
+
+void LazyImage::SetPath(int id, const char *path)
+{
+    image.id = id;
+    image.path = path;
+}
+
+void LazyImage::Prefetch()
+{
+    if (started) { return; }
+    started = true;
+    decoder = std::thread([this] {
+#ifdef POKEPONG_TRACE
+        trace_set_thread_name("prefetch");
+#endif
+        decode_image(image);
+    });
+}
+
+const LoadedImage& LazyImage::Get()
+{
+    uint64_t start = clock_counter();
+    if (!started)
+    {
+        started = true;
+        decode_image(image);
+    }
+    else if (decoder.joinable()) { decoder.join(); }
+    wait_seconds = (double) (clock_counter() - start) / clock_frequency();
+    return image;
+}
+
+void LazyImage::Release()
+{
+    if (decoder.joinable()) { decoder.join(); }
+    free_image(image);
+}
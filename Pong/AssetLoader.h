@@ -0,0 +1,94 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Decoding threads, startup only has a handful of images
+const int ASSET_LOADER_MAX_THREADS = 4;
+
+// A decoded RGBA8 image, pixels NULL if the file couldn't be read.
+// Owned by whoever took it off the loader, freed with free_image().
+struct LoadedImage
+{
+    int id;
+    const char *path;
+    int width, height;
+    unsigned char *pixels;
+    double decode_seconds;
+};
+
+// Decodes image.path into image on the calling thread, false on failure.
+// The path resolves as AssetSource.h describes.
+bool decode_image(LoadedImage &image);
+void free_image(LoadedImage &image);
+
+// Decodes images on a pool of worker threads while the caller gets on
+// with other startup work, such as creating the window and GL context.
+// Finished images come back in completion order through Next().
+class AssetLoader {
+    public:
+        AssetLoader();
+        ~AssetLoader();
+
+        // Queue everything first, Start() sizes the pool to the work.
+        // path must outlive the load.
+        void Queue(int id, const char *path);
+        // threads 0 picks from the core count
+        void Start(int threads = 0);
+        // Waits for the next finished image, false once every queued one
+        // has been handed out
+        bool Next(LoadedImage &image);
+        // Joins the workers, frees anything not taken
+        void Stop();
+
+        // Since Start(): until the last decode finished, time spent
+        // decoding across all threads, and the slowest single image
+        double wall_seconds;
+        double decode_seconds;
+        double slowest_seconds;
+        int threads;
+
+    private:
+        void WorkerLoop();
+
+        std::deque<LoadedImage> jobs;
+        std::deque<LoadedImage> finished;
+        size_t outstanding;
+        uint64_t start_counter;
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable done;
+};
+
+// An image that stays on disk until it is wanted. Prefetch() decodes it on
+// a background thread ahead of time; Get() waits for that, or decodes on
+// the spot if nothing asked earlier.
+class LazyImage {
+    public:
+        LazyImage();
+        ~LazyImage();
+
+        // path must outlive the handle
+        void SetPath(int id, const char *path);
+        // Starts the decode in the background, does nothing once started
+        void Prefetch();
+        bool Requested() const { return started; }
+        // Finished image, pixels NULL on failure. They stay with the
+        // handle until Release().
+        const LoadedImage& Get();
+        // Frees the pixels, for once they have been uploaded
+        void Release();
+
+        // How long Get() blocked, 0 if a prefetch had finished in time
+        double wait_seconds;
+
+    private:
+        LoadedImage image;
+        bool started;
+        std::thread decoder;
+};
@@ -0,0 +1,274 @@
+#include "AssetPack.h"
+#include "Logger.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// The layout is the file format, keep it free of padding
+static_assert(sizeof(AssetPackHeader) == 16, "AssetPackHeader layout");
+static_assert(sizeof(AssetPackEntry) == 112, "AssetPackEntry layout");
+static_assert(sizeof(AssetPackSource) == 80, "AssetPackSource layout");
+static_assert(sizeof(AssetPackRect) == 32, "AssetPackRect layout");
+
+static uint64_t align_up(uint64_t value)
+{
+    return (value + ASSET_PACK_ALIGNMENT - 1) / ASSET_PACK_ALIGNMENT * ASSET_PACK_ALIGNMENT;
+}
+
+static void copy_name(char *target, const char *name)
+{
+    memset(target, 0, ASSET_PACK_NAME_BYTES);
+    memcpy(target, name, std::min(strlen(name), ASSET_PACK_NAME_BYTES - 1));
+}
+
+bool stat_pack_source(const char *path, AssetPackSource &source)
+{
+    copy_name(source.path, path);
+    struct stat info;
+    if (stat(path, &info) != 0) { return false; }
+    source.modified = (int64_t) info.st_mtime;
+    source.size = (int64_t) info.st_size;
+    return true;
+}
+
+void AssetPackWriter::AddImage(const char *path, int width, int height, const unsigned char *pixels)
+{
+    Pending pending;
+    memset(&pending.entry, 0, sizeof(pending.entry));
+    copy_name(pending.entry.name, path);
+    pending.entry.kind = ASSET_PACK_IMAGE;
+    pending.entry.width = width;
+    pending.entry.height = height;
+    AssetPackSource source;
+    stat_pack_source(path, source);
+    pending.sources.push_back(source);
+    pending.pixels.assign(pixels, pixels + (size_t) width * height * 4);
+    entries.push_back(pending);
+}
+
+void AssetPackWriter::AddAtlas(const char *name, const std::vector<std::string> &paths, const AtlasLayout &layout)
+{
+    Pending pending;
+    memset(&pending.entry, 0, sizeof(pending.entry));
+    copy_name(pending.entry.name, name);
+    pending.entry.kind = ASSET_PACK_ATLAS;
+    pending.entry.width = layout.width;
+    pending.entry.height = layout.height;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        AssetPackSource source;
+        stat_pack_source(paths[i].c_str(), source);
+        pending.sources.push_back(source);
+        const AtlasRect &rect = layout.rects[i];
+        AssetPackRect packed = { rect.x, rect.y, rect.width, rect.height, rect.u0, rect.v0, rect.u1, rect.v1 };
+        pending.rects.push_back(packed);
+    }
+    pending.pixels = layout.pixels;
+    entries.push_back(pending);
+}
+
+bool AssetPackWriter::Write(const char *path) const
+{
+    // Lay out the tables after the entries, then the aligned payloads
+    std::vector<AssetPackEntry> table;
+    uint64_t offset = sizeof(AssetPackHeader) + entries.size() * sizeof(AssetPackEntry);
+    for (const Pending &pending : entries)
+    {
+        AssetPackEntry entry = pending.entry;
+        entry.source_count = (uint32_t) pending.sources.size();
+        entry.sources_offset = offset;
+        offset += pending.sources.size() * sizeof(AssetPackSource);
+        entry.rects_offset = pending.rects.empty() ? 0 : offset;
+        offset += pending.rects.size() * sizeof(AssetPackRect);
+        table.push_back(entry);
+    }
+    for (AssetPackEntry &entry : table)
+    {
+        offset = align_up(offset);
+        entry.pixels_offset = offset;
+        entry.pixels_size = (uint64_t) entry.width * entry.height * 4;
+        offset += entry.pixels_size;
+    }
+
+    std::string temporary = std::string(path) + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == NULL)
+    {
+        LOG_ERROR("Unable to open " << temporary);
+        return false;
+    }
+    AssetPackHeader header;
+    memcpy(header.magic, ASSET_PACK_MAGIC, sizeof(header.magic));
+    header.version = ASSET_PACK_VERSION;
+    header.entry_count = (uint32_t) table.size();
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+    if (!table.empty()) { ok = ok and fwrite(table.data(), sizeof(AssetPackEntry), table.size(), file) == table.size(); }
+    for (const Pending &pending : entries)
+    {
+        ok = ok and fwrite(pending.sources.data(), sizeof(AssetPackSource), pending.sources.size(), file)
+                    == pending.sources.size();
+        if (!pending.rects.empty())
+        {
+            ok = ok and fwrite(pending.rects.data(), sizeof(AssetPackRect), pending.rects.size(), file)
+                        == pending.rects.size();
+        }
+    }
+    static const unsigned char ZEROES[ASSET_PACK_ALIGNMENT] = { 0 };
+    for (size_t i = 0; i < entries.size() and ok; i++)
+    {
+        long position = ftell(file);
+        size_t gap = position >= 0 ? (size_t) (table[i].pixels_offset - position) : 0;
+        ok = position >= 0 and fwrite(ZEROES, 1, gap, file) == gap;
+        ok = ok and fwrite(entries[i].pixels.data(), 1, entries[i].pixels.size(), file) == entries[i].pixels.size();
+    }
+    ok = fclose(file) == 0 and ok;
+    // Windows won't rename over an existing file
+    remove(path);
+    if (!ok or rename(temporary.c_str(), path) != 0)
+    {
+        LOG_ERROR("Unable to write " << path);
+        remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+AssetPack::AssetPack() : data(NULL), size(0)
+#ifdef _WIN32
+    , file_handle(NULL), mapping_handle(NULL)
+#endif
+{
+}
+
+AssetPack::~AssetPack()
+{
+    Close();
+}
+
+bool AssetPack::Open(const char *path)
+{
+    Close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) { return false; }
+    LARGE_INTEGER file_size;
+    HANDLE mapping = GetFileSizeEx(file, &file_size) ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    void *view = mapping != NULL ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+    if (view == NULL)
+    {
+        if (mapping != NULL) { CloseHandle(mapping); }
+        CloseHandle(file);
+        return false;
+    }
+    file_handle = file;
+    mapping_handle = mapping;
+    data = (const unsigned char*) view;
+    size = (size_t) file_size.QuadPart;
+#else
+    int descriptor = open(path, O_RDONLY);
+    if (descriptor < 0) { return false; }
+    struct stat info;
+    void *view = MAP_FAILED;
+    if (fstat(descriptor, &info) == 0 and info.st_size > 0)
+    {
+        view = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    }
+    // The mapping keeps the file alive
+    close(descriptor);
+    if (view == MAP_FAILED) { return false; }
+    data = (const unsigned char*) view;
+    size = (size_t) info.st_size;
+#endif
+    if (!Validate())
+    {
+        LOG_WARN("Asset pack " << path << " is damaged or from another version, ignoring it");
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void AssetPack::Close()
+{
+    if (data == NULL) { return; }
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+    CloseHandle((HANDLE) mapping_handle);
+    CloseHandle((HANDLE) file_handle);
+#else
+    munmap((void*) data, size);
+#endif
+    data = NULL;
+    size = 0;
+}
+
+// Checks every offset once, so the accessors can trust them
+bool AssetPack::Validate() const
+{
+    if (size < sizeof(AssetPackHeader)) { return false; }
+    const AssetPackHeader *header = (const AssetPackHeader*) data;
+    if (memcmp(header->magic, ASSET_PACK_MAGIC, sizeof(header->magic)) != 0) { return false; }
+    if (header->version != ASSET_PACK_VERSION) { return false; }
+    if (header->entry_count > (size - sizeof(AssetPackHeader)) / sizeof(AssetPackEntry)) { return false; }
+    const AssetPackEntry *entries = (const AssetPackEntry*) (data + sizeof(AssetPackHeader));
+    for (uint32_t i = 0; i < header->entry_count; i++)
+    {
+        const AssetPackEntry &entry = entries[i];
+        if (entry.name[ASSET_PACK_NAME_BYTES - 1] != '\0') { return false; }
+        uint64_t sources_bytes = (uint64_t) entry.source_count * sizeof(AssetPackSource);
+        uint64_t rects_bytes = entry.kind == ASSET_PACK_ATLAS ? (uint64_t) entry.source_count * sizeof(AssetPackRect) : 0;
+        if (entry.sources_offset > size or sources_bytes > size - entry.sources_offset) { return false; }
+        if (rects_bytes > 0 and (entry.rects_offset > size or rects_bytes > size - entry.rects_offset)) { return false; }
+        if (entry.pixels_size != (uint64_t) entry.width * entry.height * 4) { return false; }
+        if (entry.pixels_offset > size or entry.pixels_size > size - entry.pixels_offset) { return false; }
+    }
+    return true;
+}
+
+const AssetPackEntry* AssetPack::Find(const char *name) const
+{
+    if (data == NULL) { return NULL; }
+    const AssetPackHeader *header = (const AssetPackHeader*) data;
+    const AssetPackEntry *entries = (const AssetPackEntry*) (data + sizeof(AssetPackHeader));
+    for (uint32_t i = 0; i < header->entry_count; i++)
+    {
+        if (strcmp(entries[i].name, name) == 0) { return &entries[i]; }
+    }
+    return NULL;
+}
+
+bool AssetPack::IsFresh(const AssetPackEntry &entry, const std::string &directory) const
+{
+    const AssetPackSource *sources = Sources(entry);
+    for (uint32_t i = 0; i < entry.source_count; i++)
+    {
+        AssetPackSource current;
+        if (!stat_pack_source((directory + sources[i].path).c_str(), current)) { continue; }
+        if (current.modified != sources[i].modified or current.size != sources[i].size) { return false; }
+    }
+    return true;
+}
+
+const AssetPackSource* AssetPack::Sources(const AssetPackEntry &entry) const
+{
+    return (const AssetPackSource*) (data + entry.sources_offset);
+}
+
+const AssetPackRect* AssetPack::Rects(const AssetPackEntry &entry) const
+{
+    return entry.kind == ASSET_PACK_ATLAS ? (const AssetPackRect*) (data + entry.rects_offset) : NULL;
+}
+
+const unsigned char* AssetPack::Pixels(const AssetPackEntry &entry) const
+{
+    return data + entry.pixels_offset;
+}
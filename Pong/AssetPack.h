@@ -0,0 +1,117 @@
+#pragma once
+
+#include "AtlasPacker.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Pre-decoded images in one file, laid out to be memory-mapped and handed
+// straight to glTexImage2D. All fields are little-endian and sizes fixed:
+//
+//   AssetPackHeader
+//   AssetPackEntry       x entry_count
+//   AssetPackSource      per entry, at sources_offset
+//   AssetPackRect        per atlas entry, at rects_offset, one per source
+//   RGBA8 pixels         per entry, at pixels_offset, ASSET_PACK_ALIGNMENT aligned
+const char ASSET_PACK_MAGIC[8] = { 'P', 'K', 'P', 'A', 'C', 'K', '\0', '\0' };
+const uint32_t ASSET_PACK_VERSION = 1;
+// Payloads start on page boundaries
+const uint64_t ASSET_PACK_ALIGNMENT = 4096;
+// Longest name or source path kept, including the terminator
+const size_t ASSET_PACK_NAME_BYTES = 64;
+
+enum AssetPackKind
+{
+    // One image, named after its source file
+    ASSET_PACK_IMAGE = 1,
+    // Several images packed by pack_atlas(), rects in source order
+    ASSET_PACK_ATLAS = 2
+};
+
+struct AssetPackHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t entry_count;
+};
+
+struct AssetPackEntry
+{
+    char name[ASSET_PACK_NAME_BYTES];
+    uint32_t kind;
+    uint32_t width, height;
+    uint32_t source_count;
+    uint64_t sources_offset;
+    uint64_t rects_offset;
+    uint64_t pixels_offset;
+    uint64_t pixels_size;
+};
+
+// A file an entry was cooked from, to tell when the pack is stale
+struct AssetPackSource
+{
+    char path[ASSET_PACK_NAME_BYTES];
+    int64_t modified;
+    int64_t size;
+};
+
+struct AssetPackRect
+{
+    int32_t x, y, width, height;
+    float u0, v0, u1, v1;
+};
+
+// Fills in a source from the file on disk, false if it can't be read
+bool stat_pack_source(const char *path, AssetPackSource &source);
+
+// Builds a pack in memory, for the cooker
+class AssetPackWriter {
+    public:
+        void AddImage(const char *path, int width, int height, const unsigned char *pixels);
+        void AddAtlas(const char *name, const std::vector<std::string> &paths, const AtlasLayout &layout);
+        // Written to a temporary file first, so a reader never sees half of it
+        bool Write(const char *path) const;
+
+    private:
+        struct Pending
+        {
+            AssetPackEntry entry;
+            std::vector<AssetPackSource> sources;
+            std::vector<AssetPackRect> rects;
+            std::vector<unsigned char> pixels;
+        };
+
+        std::vector<Pending> entries;
+};
+
+// A pack mapped read-only. Pixels() points into the mapping, so nothing is
+// decoded or copied; it stays valid until Close().
+class AssetPack {
+    public:
+        AssetPack();
+        ~AssetPack();
+
+        bool Open(const char *path);
+        void Close();
+        bool IsOpen() const { return data != NULL; }
+
+        const AssetPackEntry* Find(const char *name) const;
+        // Whether every source still matches what was cooked. Sources that
+        // are gone count as fresh, so a pack can ship without them. Source
+        // paths are looked up under directory.
+        bool IsFresh(const AssetPackEntry &entry, const std::string &directory = "") const;
+        const AssetPackSource* Sources(const AssetPackEntry &entry) const;
+        const AssetPackRect* Rects(const AssetPackEntry &entry) const;
+        const unsigned char* Pixels(const AssetPackEntry &entry) const;
+
+    private:
+        bool Validate() const;
+
+        const unsigned char *data;
+        size_t size;
+#ifdef _WIN32
+        void *file_handle;
+        void *mapping_handle;
+#endif
+};
@@ -0,0 +1,60 @@
+#include "AssetSource.h"
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef POKEPONG_EMBED_ASSETS
+// Generated into the build directory, see embed_assets.py
+#include "EmbeddedAssetData.h"
+#else
+static const EmbeddedAsset *const EMBEDDED_ASSETS = NULL;
+static const size_t EMBEDDED_ASSET_COUNT = 0;
+#endif
+
+const std::string& asset_directory()
+{
+    static const std::string directory = []() {
+        const char *value = getenv("POKEPONG_ASSET_DIR");
+        std::string result = value != NULL ? value : "";
+        if (!result.empty() and result.back() != '/') { result += '/'; }
+        return result;
+    }();
+    return directory;
+}
+
+bool assets_embedded()
+{
+    return EMBEDDED_ASSET_COUNT > 0 and asset_directory().empty();
+}
+
+const EmbeddedAsset* find_embedded_asset(const char *path)
+{
+    if (!assets_embedded()) { return NULL; }
+    for (size_t i = 0; i < EMBEDDED_ASSET_COUNT; i++)
+    {
+        if (strcmp(EMBEDDED_ASSETS[i].path, path) == 0) { return &EMBEDDED_ASSETS[i]; }
+    }
+    return NULL;
+}
+
+std::string asset_path(const char *path)
+{
+    return asset_directory() + path;
+}
+
+bool read_asset(const char *path, std::string &contents)
+{
+    const EmbeddedAsset *asset = find_embedded_asset(path);
+    if (asset != NULL)
+    {
+        contents.assign((const char*) asset->data, asset->size);
+        return true;
+    }
+    std::ifstream file(asset_path(path), std::ios::binary);
+    if (file.fail()) { return false; }
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+
+// A file built into the executable by embed_assets.py
+struct EmbeddedAsset
+{
+    const char *path;
+    const unsigned char *data;
+    size_t size;
+};
+
+// Shaders and sprites are looked up by their path relative to the Pong
+// directory and come from, in order: the directory POKEPONG_ASSET_DIR
+// names, for trying out edits without a rebuild; the copies embedded at
+// build time when POKEPONG_EMBED_ASSETS is defined; the working directory.
+
+// The override directory ending in a slash, empty when unset
+const std::string& asset_directory();
+// Whether assets come out of the executable rather than off disk
+bool assets_embedded();
+// The embedded copy of path, NULL when there is none or it is overridden
+const EmbeddedAsset* find_embedded_asset(const char *path);
+// Where to open path on disk
+std::string asset_path(const char *path);
+// The whole of an asset, from wherever it resolves to
+bool read_asset(const char *path, std::string &contents);
@@ -0,0 +1,146 @@
+#include "AtlasPacker.h"
+#include <algorithm>
+#include <string.h>
+
+void SkylinePacker::Reset(int sheet_width, int sheet_height)
+{
+    width = sheet_width;
+    height = sheet_height;
+    skyline.clear();
+    Segment floor = { 0, 0, sheet_width };
+    skyline.push_back(floor);
+}
+
+int SkylinePacker::Fit(size_t index, int rect_width, int rect_height) const
+{
+    if (skyline[index].x + rect_width > width) { return -1; }
+    // The rect rests on the highest segment it spans
+    int y = 0;
+    int remaining = rect_width;
+    for (size_t i = index; remaining > 0; i++)
+    {
+        if (i == skyline.size()) { return -1; }
+        y = std::max(y, skyline[i].y);
+        if (y + rect_height > height) { return -1; }
+        remaining -= skyline[i].width;
+    }
+    return y;
+}
+
+bool SkylinePacker::Insert(int rect_width, int rect_height, int &x, int &y)
+{
+    // Lowest spot, ties go to the narrowest segment
+    int best_index = -1, best_y = height, best_width = width + 1;
+    for (size_t i = 0; i < skyline.size(); i++)
+    {
+        int fit_y = Fit(i, rect_width, rect_height);
+        if (fit_y < 0) { continue; }
+        if (fit_y < best_y or (fit_y == best_y and skyline[i].width < best_width))
+        {
+            best_index = (int) i;
+            best_y = fit_y;
+            best_width = skyline[i].width;
+        }
+    }
+    if (best_index < 0) { return false; }
+
+    x = skyline[best_index].x;
+    y = best_y;
+
+    // New segment on top of the rect, then trim whatever it covers
+    Segment top = { x, y + rect_height, rect_width };
+    skyline.insert(skyline.begin() + best_index, top);
+    for (size_t i = best_index + 1; i < skyline.size();)
+    {
+        Segment &segment = skyline[i];
+        int covered = top.x + top.width - segment.x;
+        if (covered <= 0) { break; }
+        if (covered < segment.width)
+        {
+            segment.x += covered;
+            segment.width -= covered;
+            break;
+        }
+        skyline.erase(skyline.begin() + i);
+    }
+
+    // Merge neighbours at the same height
+    for (size_t i = 0; i + 1 < skyline.size();)
+    {
+        if (skyline[i].y == skyline[i + 1].y)
+        {
+            skyline[i].width += skyline[i + 1].width;
+            skyline.erase(skyline.begin() + i + 1);
+        }
+        else { i++; }
+    }
+    return true;
+}
+
+// Copies an image into the sheet and extrudes its edges into the padding
+static void blit_padded(const AtlasImage &image, const AtlasRect &rect, AtlasLayout &layout)
+{
+    for (int row = -ATLAS_PADDING; row < image.height + ATLAS_PADDING; row++)
+    {
+        int source_row = std::min(std::max(row, 0), image.height - 1);
+        for (int column = -ATLAS_PADDING; column < image.width + ATLAS_PADDING; column++)
+        {
+            int source_column = std::min(std::max(column, 0), image.width - 1);
+            const unsigned char *source = image.pixels + ((size_t) source_row * image.width + source_column) * 4;
+            unsigned char *target = &layout.pixels[((size_t) (rect.y + row) * layout.width + rect.x + column) * 4];
+            memcpy(target, source, 4);
+        }
+    }
+}
+
+bool pack_atlas(const std::vector<AtlasImage> &images, AtlasLayout &layout)
+{
+    // Tallest first packs tighter on a skyline
+    std::vector<size_t> order(images.size());
+    size_t area = 0;
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        order[i] = i;
+        area += (size_t) (images[i].width + 2 * ATLAS_PADDING) * (images[i].height + 2 * ATLAS_PADDING);
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return images[a].height > images[b].height; });
+
+    // Grow the sheet, alternating sides, until everything fits
+    int width = 64, height = 64;
+    while ((size_t) width * height < area) { if (width <= height) { width *= 2; } else { height *= 2; } }
+    SkylinePacker packer;
+    layout.rects.assign(images.size(), AtlasRect());
+    for (;;)
+    {
+        packer.Reset(width, height);
+        bool fits = true;
+        for (size_t i = 0; i < order.size() and fits; i++)
+        {
+            const AtlasImage &image = images[order[i]];
+            int x, y;
+            fits = packer.Insert(image.width + 2 * ATLAS_PADDING, image.height + 2 * ATLAS_PADDING, x, y);
+            AtlasRect &rect = layout.rects[order[i]];
+            rect.x = x + ATLAS_PADDING;
+            rect.y = y + ATLAS_PADDING;
+            rect.width = image.width;
+            rect.height = image.height;
+        }
+        if (fits) { break; }
+        if (width >= ATLAS_MAX_SIZE and height >= ATLAS_MAX_SIZE) { return false; }
+        if (width <= height) { width *= 2; } else { height *= 2; }
+    }
+
+    layout.width = width;
+    layout.height = height;
+    layout.pixels.assign((size_t) width * height * 4, 0);
+    for (size_t i = 0; i < images.size(); i++)
+    {
+        AtlasRect &rect = layout.rects[i];
+        rect.u0 = (float) rect.x / width;
+        rect.v0 = (float) rect.y / height;
+        rect.u1 = (float) (rect.x + rect.width) / width;
+        rect.v1 = (float) (rect.y + rect.height) / height;
+        blit_padded(images[i], rect, layout);
+    }
+    return true;
+}
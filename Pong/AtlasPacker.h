@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Transparent border around every image, filled by repeating its edge
+// pixels so filtering never picks up a neighbour
+const int ATLAS_PADDING = 2;
+// Largest atlas side tried before giving up
+const int ATLAS_MAX_SIZE = 4096;
+
+// One RGBA8 image to pack, pixels are not owned
+struct AtlasImage
+{
+    int width, height;
+    const unsigned char *pixels;
+};
+
+// Where an image ended up, in pixels and as texture coordinates.
+// v0 is the top row of the image, like UvRect in SpriteTypes.h.
+struct AtlasRect
+{
+    int x, y, width, height;
+    float u0, v0, u1, v1;
+};
+
+// Packed sheet, rects in the same order as the input images
+struct AtlasLayout
+{
+    int width, height;
+    std::vector<AtlasRect> rects;
+    std::vector<unsigned char> pixels;
+};
+
+// Skyline bottom-left packer: keeps the top edge of what has been placed
+// as a list of segments and drops each rect where it ends up lowest
+class SkylinePacker {
+    public:
+        void Reset(int width, int height);
+        bool Insert(int width, int height, int &x, int &y);
+
+    private:
+        struct Segment
+        {
+            int x, y, width;
+        };
+
+        // Height the rect would sit at if placed at segment index, or -1
+        int Fit(size_t index, int width, int height) const;
+
+        int width, height;
+        std::vector<Segment> skyline;
+};
+
+// Packs the images into the smallest power-of-two sheet that holds them and
+// copies their pixels in with padding. No GL, so tools can use it too.
+bool pack_atlas(const std::vector<AtlasImage> &images, AtlasLayout &layout);
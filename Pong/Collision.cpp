@@ -0,0 +1,182 @@
+#include "Collision.h"
+#include <math.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Entry and exit times of a point moving by move along one axis, against
+// the slab [-extent, extent] around it
+static bool slab_times(float position, float move, float extent, float &entry, float &exit)
+{
+    if (move == 0.0f)
+    {
+        if (fabsf(position) >= extent) { return false; }
+        entry = -INFINITY;
+        exit = INFINITY;
+        return true;
+    }
+    float t1 = (-extent - position) / move;
+    float t2 = (extent - position) / move;
+    entry = fminf(t1, t2);
+    exit = fmaxf(t1, t2);
+    return true;
+}
+
+bool swept_aabb(const Aabb &moving, float move_x, float move_y,
+                const Aabb &target, float target_move_x, float target_move_y,
+                SweptHit &hit)
+{
+    // Shrink the moving box to a point and grow the target by its size,
+    // then work in the target's frame
+    float extent_x = moving.half_x + target.half_x;
+    float extent_y = moving.half_y + target.half_y;
+    float position_x = moving.center_x - target.center_x;
+    float position_y = moving.center_y - target.center_y;
+    float relative_x = move_x - target_move_x;
+    float relative_y = move_y - target_move_y;
+
+    float entry_x, exit_x, entry_y, exit_y;
+    if (!slab_times(position_x, relative_x, extent_x, entry_x, exit_x)) { return false; }
+    if (!slab_times(position_y, relative_y, extent_y, entry_y, exit_y)) { return false; }
+
+    float entry = fmaxf(entry_x, entry_y);
+    float exit = fminf(exit_x, exit_y);
+    if (entry >= exit or exit <= 0.0f or entry > 1.0f) { return false; }
+
+    hit.normal_x = 0.0f;
+    hit.normal_y = 0.0f;
+    hit.started_inside = entry < 0.0f;
+    if (!hit.started_inside)
+    {
+        // The axis entered last is the face that was hit
+        if (entry_x > entry_y) { hit.normal_x = relative_x > 0.0f ? -1.0f : 1.0f; }
+        else { hit.normal_y = relative_y > 0.0f ? -1.0f : 1.0f; }
+        hit.time = entry;
+        return true;
+    }
+
+    // Already overlapping, push out along the shallower axis while the boxes
+    // keep closing in on it
+    bool along_x = extent_x - fabsf(position_x) < extent_y - fabsf(position_y);
+    if (along_x) { hit.normal_x = position_x < 0.0f ? -1.0f : 1.0f; }
+    else { hit.normal_y = position_y < 0.0f ? -1.0f : 1.0f; }
+    float closing = along_x ? position_x * relative_x : position_y * relative_y;
+    if (closing >= 0.0f) { return false; }
+    hit.time = 0.0f;
+    return true;
+}
+
+static void one_vs_many_scalar(float center_x, float center_y, float half_x, float half_y,
+                               const AabbArrays &bodies, uint32_t *mask, size_t begin)
+{
+    for (size_t i = begin; i < bodies.count; i++)
+    {
+        float x_distance = fabsf(center_x - bodies.center_x[i]) - (half_x + bodies.half_x[i]);
+        float y_distance = fabsf(center_y - bodies.center_y[i]) - (half_y + bodies.half_y[i]);
+        if (x_distance < 0 && y_distance < 0)
+        {
+            mask[i / 32] |= 1u << (i % 32);
+        }
+    }
+}
+
+#ifdef __SSE2__
+
+// Four bodies per iteration, the rest go through the scalar loop
+static void one_vs_many_sse2(float center_x, float center_y, float half_x, float half_y,
+                             const AabbArrays &bodies, uint32_t *mask)
+{
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 cx = _mm_set1_ps(center_x), cy = _mm_set1_ps(center_y);
+    const __m128 hx = _mm_set1_ps(half_x), hy = _mm_set1_ps(half_y);
+
+    size_t i = 0;
+    for (; i + 4 <= bodies.count; i += 4)
+    {
+        __m128 x_distance = _mm_sub_ps(_mm_and_ps(_mm_sub_ps(cx, _mm_loadu_ps(bodies.center_x + i)), abs_mask),
+                                       _mm_add_ps(hx, _mm_loadu_ps(bodies.half_x + i)));
+        __m128 y_distance = _mm_sub_ps(_mm_and_ps(_mm_sub_ps(cy, _mm_loadu_ps(bodies.center_y + i)), abs_mask),
+                                       _mm_add_ps(hy, _mm_loadu_ps(bodies.half_y + i)));
+        __m128 hit = _mm_and_ps(_mm_cmplt_ps(x_distance, zero), _mm_cmplt_ps(y_distance, zero));
+        mask[i / 32] |= (uint32_t) _mm_movemask_ps(hit) << (i % 32);
+    }
+    one_vs_many_scalar(center_x, center_y, half_x, half_y, bodies, mask, i);
+}
+
+#endif
+
+#ifdef POKEPONG_X86_DISPATCH
+
+// Eight bodies per iteration, the rest go through the scalar loop
+__attribute__((target("avx2")))
+static void one_vs_many_avx2(float center_x, float center_y, float half_x, float half_y,
+                             const AabbArrays &bodies, uint32_t *mask)
+{
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 cx = _mm256_set1_ps(center_x), cy = _mm256_set1_ps(center_y);
+    const __m256 hx = _mm256_set1_ps(half_x), hy = _mm256_set1_ps(half_y);
+
+    size_t i = 0;
+    for (; i + 8 <= bodies.count; i += 8)
+    {
+        __m256 x_distance = _mm256_sub_ps(_mm256_and_ps(_mm256_sub_ps(cx, _mm256_loadu_ps(bodies.center_x + i)), abs_mask),
+                                          _mm256_add_ps(hx, _mm256_loadu_ps(bodies.half_x + i)));
+        __m256 y_distance = _mm256_sub_ps(_mm256_and_ps(_mm256_sub_ps(cy, _mm256_loadu_ps(bodies.center_y + i)), abs_mask),
+                                          _mm256_add_ps(hy, _mm256_loadu_ps(bodies.half_y + i)));
+        __m256 hit = _mm256_and_ps(_mm256_cmp_ps(x_distance, zero, _CMP_LT_OQ),
+                                   _mm256_cmp_ps(y_distance, zero, _CMP_LT_OQ));
+        mask[i / 32] |= (uint32_t) _mm256_movemask_ps(hit) << (i % 32);
+    }
+    one_vs_many_scalar(center_x, center_y, half_x, half_y, bodies, mask, i);
+}
+
+#endif
+
+void overlap_one_vs_many_with(SimdLevel level, float center_x, float center_y,
+                              float half_x, float half_y,
+                              const AabbArrays &bodies, uint32_t *mask)
+{
+    memset(mask, 0, overlap_mask_words(bodies.count) * sizeof(uint32_t));
+#ifdef POKEPONG_X86_DISPATCH
+    if (level == SIMD_AVX2)
+    {
+        one_vs_many_avx2(center_x, center_y, half_x, half_y, bodies, mask);
+        return;
+    }
+#endif
+#ifdef __SSE2__
+    if (level >= SIMD_SSE2)
+    {
+        one_vs_many_sse2(center_x, center_y, half_x, half_y, bodies, mask);
+        return;
+    }
+#endif
+    one_vs_many_scalar(center_x, center_y, half_x, half_y, bodies, mask, 0);
+}
+
+SimdLevel overlap_simd_level()
+{
+    static const SimdLevel level = detect_simd_level();
+    return level;
+}
+
+void overlap_one_vs_many(float center_x, float center_y, float half_x, float half_y,
+                         const AabbArrays &bodies, uint32_t *mask)
+{
+    overlap_one_vs_many_with(overlap_simd_level(), center_x, center_y, half_x, half_y, bodies, mask);
+}
+
+void overlap_many_vs_many(const AabbArrays &a, const AabbArrays &b, uint32_t *mask)
+{
+    SimdLevel level = overlap_simd_level();
+    size_t row_words = overlap_mask_words(b.count);
+    for (size_t r = 0; r < a.count; r++)
+    {
+        overlap_one_vs_many_with(level, a.center_x[r], a.center_y[r], a.half_x[r], a.half_y[r],
+                                 b, mask + r * row_words);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Axis-aligned box
+struct Aabb
+{
+    float center_x, center_y;
+    float half_x, half_y;
+};
+
+// First contact found by swept_aabb()
+struct SweptHit
+{
+    float time;         // fraction of the move, in [0, 1]
+    float normal_x;     // contact normal on the target box, one axis is 0
+    float normal_y;
+    bool started_inside;    // boxes already overlapped at the start of the move
+};
+
+// Continuous test for a box moving by (move_x, move_y) against a box moving
+// by (target_move_x, target_move_y) over the same interval. Returns true and
+// fills hit when they touch during the move while approaching each other.
+// Boxes that already overlap report time 0 if they are still closing in,
+// with the normal on the axis of least penetration.
+bool swept_aabb(const Aabb &moving, float move_x, float move_y,
+                const Aabb &target, float target_move_x, float target_move_y,
+                SweptHit &hit);
+
+// Packed axis-aligned boxes, one array per component
+struct AabbArrays
+{
+    const float *center_x;
+    const float *center_y;
+    const float *half_x;
+    const float *half_y;
+    size_t count;
+};
+
+// Number of 32-bit mask words needed for count bodies
+inline size_t overlap_mask_words(size_t count) { return (count + 31) / 32; }
+
+// Tests one box against every body. Bit i of mask is set when body i
+// overlaps, with the same strict test as collided().
+void overlap_one_vs_many(float center_x, float center_y, float half_x, float half_y,
+                         const AabbArrays &bodies, uint32_t *mask);
+
+// Tests every box in a against every box in b. Row r of the mask starts at
+// mask + r * overlap_mask_words(b.count).
+void overlap_many_vs_many(const AabbArrays &a, const AabbArrays &b, uint32_t *mask);
+
+// Kernel used by the functions above, picked once from detect_simd_level()
+SimdLevel overlap_simd_level();
+
+// Runs one kernel directly, for benchmarks and cross-checking
+void overlap_one_vs_many_with(SimdLevel level, float center_x, float center_y,
+                              float half_x, float half_y,
+                              const AabbArrays &bodies, uint32_t *mask);
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define POKEPONG_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+// SIMD kernels available at runtime, best last
+enum SimdLevel
+{
+    SIMD_SCALAR = 0,
+    SIMD_SSE2   = 1,
+    SIMD_AVX2   = 2
+};
+
+inline const char* simd_level_name(SimdLevel level)
+{
+    switch (level)
+    {
+        case SIMD_AVX2: return "avx2";
+        case SIMD_SSE2: return "sse2";
+        default:        return "scalar";
+    }
+}
+
+// Best level supported by this CPU. POKEPONG_SIMD=scalar|sse2|avx2 caps it,
+// which is handy when comparing kernels.
+inline SimdLevel detect_simd_level()
+{
+    SimdLevel level = SIMD_SCALAR;
+#ifdef POKEPONG_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) { level = SIMD_SSE2; }
+    if (__builtin_cpu_supports("avx2")) { level = SIMD_AVX2; }
+#endif
+    const char* cap = getenv("POKEPONG_SIMD");
+    if (cap != NULL)
+    {
+        SimdLevel requested = SIMD_SCALAR;
+        if (strcmp(cap, "avx2") == 0) { requested = SIMD_AVX2; }
+        else if (strcmp(cap, "sse2") == 0) { requested = SIMD_SSE2; }
+        if (requested < level) { level = requested; }
+    }
+    return level;
+}
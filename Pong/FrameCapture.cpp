@@ -0,0 +1,360 @@
+#include "FrameCapture.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <array>
+#include <string.h>
+
+// Largest stored deflate block
+const size_t PNG_STORED_BLOCK = 65535;
+
+CaptureFormat capture_format_for_path(const char *path)
+{
+    size_t length = strlen(path);
+    return length >= 4 and strcmp(path + length - 4, ".y4m") == 0 ? CAPTURE_Y4M : CAPTURE_PNG;
+}
+
+static std::array<uint32_t, 256> make_crc_table()
+{
+    std::array<uint32_t, 256> table;
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) { c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1; }
+        table[n] = c;
+    }
+    return table;
+}
+
+static uint32_t crc32_update(uint32_t crc, const unsigned char *data, size_t length)
+{
+    // Built once even with both PNG workers racing to it
+    static const std::array<uint32_t, 256> table = make_crc_table();
+    crc = ~crc;
+    for (size_t i = 0; i < length; i++) { crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8); }
+    return ~crc;
+}
+
+static void put_u32(std::vector<unsigned char> &out, uint32_t value)
+{
+    out.push_back((unsigned char) (value >> 24));
+    out.push_back((unsigned char) (value >> 16));
+    out.push_back((unsigned char) (value >> 8));
+    out.push_back((unsigned char) value);
+}
+
+static void put_chunk(std::vector<unsigned char> &out, const char *type, const std::vector<unsigned char> &data)
+{
+    put_u32(out, (uint32_t) data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_u32(out, crc32_update(0, &out[start], out.size() - start));
+}
+
+// RGBA8 rows as a PNG with stored (uncompressed) deflate blocks, which
+// keeps encoding to a copy and a checksum
+static void encode_png(const uint32_t *pixels, int width, int height, bool bottom_up,
+                       std::vector<unsigned char> &out)
+{
+    // Filter byte 0 then the row, for every row
+    size_t row_bytes = (size_t) width * 4 + 1;
+    std::vector<unsigned char> raw(row_bytes * height);
+    for (int y = 0; y < height; y++)
+    {
+        const uint32_t *source = pixels + (size_t) (bottom_up ? height - 1 - y : y) * width;
+        raw[y * row_bytes] = 0;
+        memcpy(&raw[y * row_bytes + 1], source, (size_t) width * 4);
+    }
+
+    std::vector<unsigned char> zlib;
+    zlib.reserve(raw.size() + raw.size() / PNG_STORED_BLOCK * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    uint32_t adler_a = 1, adler_b = 0;
+    for (size_t offset = 0; offset < raw.size(); offset += PNG_STORED_BLOCK)
+    {
+        size_t length = std::min(PNG_STORED_BLOCK, raw.size() - offset);
+        zlib.push_back(offset + length == raw.size() ? 1 : 0);
+        zlib.push_back((unsigned char) length);
+        zlib.push_back((unsigned char) (length >> 8));
+        zlib.push_back((unsigned char) ~length);
+        zlib.push_back((unsigned char) (~length >> 8));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + length);
+        for (size_t i = offset; i < offset + length; i++)
+        {
+            adler_a = (adler_a + raw[i]) % 65521;
+            adler_b = (adler_b + adler_a) % 65521;
+        }
+    }
+    put_u32(zlib, (adler_b << 16) | adler_a);
+
+    static const unsigned char SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    out.assign(SIGNATURE, SIGNATURE + 8);
+    std::vector<unsigned char> header;
+    put_u32(header, (uint32_t) width);
+    put_u32(header, (uint32_t) height);
+    // 8 bits, RGBA, deflate, adaptive filtering, no interlace
+    const unsigned char format[5] = { 8, 6, 0, 0, 0 };
+    header.insert(header.end(), format, format + 5);
+    put_chunk(out, "IHDR", header);
+    put_chunk(out, "IDAT", zlib);
+    put_chunk(out, "IEND", std::vector<unsigned char>());
+}
+
+FrameCapture::FrameCapture()
+    : captured(0), dropped(0), written(0), active(false), use_gl(false), format(CAPTURE_Y4M),
+      width(0), height(0), fps(0), video(NULL), next_slot(0), stopping(false)
+{
+    for (int i = 0; i < CAPTURE_PBO_COUNT; i++)
+    {
+        pixel_buffers[i] = 0;
+        pending[i] = -1;
+    }
+}
+
+FrameCapture::~FrameCapture()
+{
+    Stop();
+}
+
+bool FrameCapture::Start(const char *output_path, int frame_width, int frame_height, int frame_rate, bool gl)
+{
+    Stop();
+    path = output_path;
+    format = capture_format_for_path(output_path);
+    width = frame_width;
+    height = frame_height;
+    fps = frame_rate > 0 ? frame_rate : 60;
+    use_gl = gl;
+    captured = 0;
+    dropped = 0;
+    written.store(0);
+
+    if (format == CAPTURE_Y4M)
+    {
+        video = fopen(output_path, "wb");
+        if (video == NULL)
+        {
+            LOG_ERROR("Unable to open capture file " << output_path);
+            return false;
+        }
+        // C420jpeg: chroma halved both ways, sited between the luma samples
+        fprintf(video, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+    }
+
+    if (use_gl)
+    {
+        glGenBuffers(CAPTURE_PBO_COUNT, pixel_buffers);
+        for (int i = 0; i < CAPTURE_PBO_COUNT; i++)
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) width * height * 4, NULL, GL_STREAM_READ);
+            pending[i] = -1;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        next_slot = 0;
+    }
+
+    pool.assign(CAPTURE_QUEUE_FRAMES, Frame());
+    free_frames.clear();
+    for (Frame &frame : pool)
+    {
+        frame.pixels.resize((size_t) width * height);
+        free_frames.push_back(&frame);
+    }
+    queue.clear();
+    stopping = false;
+    int threads = format == CAPTURE_PNG ? CAPTURE_PNG_WORKERS : 1;
+    for (int i = 0; i < threads; i++) { workers.push_back(std::thread(&FrameCapture::WorkerLoop, this)); }
+    active = true;
+    return true;
+}
+
+FrameCapture::Frame* FrameCapture::AcquireFrame()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (free_frames.empty()) { return NULL; }
+    Frame *frame = free_frames.back();
+    free_frames.pop_back();
+    return frame;
+}
+
+void FrameCapture::Submit(Frame *frame)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(frame);
+    }
+    wake.notify_one();
+}
+
+void FrameCapture::CollectReadback(int slot)
+{
+    if (pending[slot] < 0) { return; }
+    Frame *frame = AcquireFrame();
+    if (frame == NULL) { dropped++; }
+    else
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers[slot]);
+        const void *mapped = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+        if (mapped != NULL)
+        {
+            memcpy(frame->pixels.data(), mapped, frame->pixels.size() * sizeof(uint32_t));
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            frame->index = (uint64_t) pending[slot];
+            frame->bottom_up = true;
+            Submit(frame);
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_frames.push_back(frame);
+            dropped++;
+        }
+    }
+    pending[slot] = -1;
+}
+
+void FrameCapture::CaptureGL()
+{
+    if (!active or !use_gl) { return; }
+    TRACE_ZONE("FrameCapture::CaptureGL");
+    int slot = next_slot;
+    next_slot = (next_slot + 1) % CAPTURE_PBO_COUNT;
+    // The frame read into this buffer CAPTURE_PBO_COUNT frames ago
+    CollectReadback(slot);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers[slot]);
+    // Returns at once, the copy lands in the buffer when the GPU gets there
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    pending[slot] = (int64_t) captured++;
+}
+
+void FrameCapture::CapturePixels(const uint32_t *pixels)
+{
+    if (!active or use_gl) { return; }
+    TRACE_ZONE("FrameCapture::CapturePixels");
+    uint64_t index = captured++;
+    Frame *frame = AcquireFrame();
+    if (frame == NULL)
+    {
+        dropped++;
+        return;
+    }
+    memcpy(frame->pixels.data(), pixels, frame->pixels.size() * sizeof(uint32_t));
+    frame->index = index;
+    frame->bottom_up = false;
+    Submit(frame);
+}
+
+void FrameCapture::Stop()
+{
+    if (!active) { return; }
+    if (use_gl)
+    {
+        // Oldest first, so the video stays in order
+        for (int i = 0; i < CAPTURE_PBO_COUNT; i++) { CollectReadback((next_slot + i) % CAPTURE_PBO_COUNT); }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        glDeleteBuffers(CAPTURE_PBO_COUNT, pixel_buffers);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) { worker.join(); }
+    workers.clear();
+    if (video != NULL)
+    {
+        fclose(video);
+        video = NULL;
+    }
+    active = false;
+    LOG("Capture: " << written.load() << " of " << captured << " frames written to " << path
+        << ", " << dropped << " dropped");
+}
+
+void FrameCapture::WorkerLoop()
+{
+#ifdef POKEPONG_TRACE
+    trace_set_thread_name("capture");
+#endif
+    for (;;)
+    {
+        Frame *frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this] { return stopping or !queue.empty(); });
+            // Whatever is queued still gets written on the way out
+            if (queue.empty()) { return; }
+            frame = queue.front();
+            queue.pop_front();
+        }
+        if (format == CAPTURE_Y4M) { WriteY4m(*frame); }
+        else { WritePng(*frame); }
+        std::lock_guard<std::mutex> lock(mutex);
+        free_frames.push_back(frame);
+    }
+}
+
+void FrameCapture::WriteY4m(const Frame &frame)
+{
+    TRACE_ZONE("FrameCapture::WriteY4m");
+    // BT.601 studio range, chroma averaged over each 2x2 block
+    int chroma_width = (width + 1) / 2, chroma_height = (height + 1) / 2;
+    size_t luma_size = (size_t) width * height, chroma_size = (size_t) chroma_width * chroma_height;
+    planes.resize(luma_size + 2 * chroma_size);
+    unsigned char *luma = planes.data(), *cb = luma + luma_size, *cr = cb + chroma_size;
+    for (int y = 0; y < height; y++)
+    {
+        const uint32_t *row = frame.pixels.data() + (size_t) (frame.bottom_up ? height - 1 - y : y) * width;
+        for (int x = 0; x < width; x++)
+        {
+            int r = row[x] & 0xFF, g = (row[x] >> 8) & 0xFF, b = (row[x] >> 16) & 0xFF;
+            luma[(size_t) y * width + x] = (unsigned char) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        }
+    }
+    for (int cy = 0; cy < chroma_height; cy++)
+    {
+        for (int cx = 0; cx < chroma_width; cx++)
+        {
+            int r = 0, g = 0, b = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                int x = std::min(cx * 2 + (i & 1), width - 1), y = std::min(cy * 2 + (i >> 1), height - 1);
+                uint32_t pixel = frame.pixels[(size_t) (frame.bottom_up ? height - 1 - y : y) * width + x];
+                r += pixel & 0xFF;
+                g += (pixel >> 8) & 0xFF;
+                b += (pixel >> 16) & 0xFF;
+            }
+            r = (r + 2) / 4;
+            g = (g + 2) / 4;
+            b = (b + 2) / 4;
+            cb[(size_t) cy * chroma_width + cx] = (unsigned char) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            cr[(size_t) cy * chroma_width + cx] = (unsigned char) (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    fputs("FRAME\n", video);
+    if (fwrite(planes.data(), 1, planes.size(), video) == planes.size()) { written++; }
+    else { LOG_ERROR("Unable to write frame " << frame.index << " to " << path); }
+}
+
+void FrameCapture::WritePng(const Frame &frame)
+{
+    TRACE_ZONE("FrameCapture::WritePng");
+    std::vector<unsigned char> png;
+    encode_png(frame.pixels.data(), width, height, frame.bottom_up, png);
+    char name[512];
+    snprintf(name, sizeof(name), "%s_%05llu.png", path.c_str(), (unsigned long long) frame.index);
+    FILE *file = fopen(name, "wb");
+    if (file == NULL)
+    {
+        LOG_ERROR("Unable to open " << name);
+        return;
+    }
+    bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+    if (fclose(file) == 0 and ok) { written++; }
+    else { LOG_ERROR("Unable to write " << name); }
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Pixel buffers GL reads frames into. A frame is mapped when its buffer
+// comes round again, by which time the copy has long finished.
+const int CAPTURE_PBO_COUNT = 3;
+// Frames waiting for the encoders before new ones are dropped
+const int CAPTURE_QUEUE_FRAMES = 8;
+// Encoder threads for numbered PNGs, Y4M is one stream and gets one
+const int CAPTURE_PNG_WORKERS = 2;
+
+enum CaptureFormat
+{
+    // Raw 4:2:0 video in one file
+    CAPTURE_Y4M,
+    // One prefix_00001.png per frame
+    CAPTURE_PNG
+};
+
+// Paths ending in .y4m are videos, anything else is a PNG prefix
+CaptureFormat capture_format_for_path(const char *path);
+
+// Grabs every presented frame without holding up the render loop: GL
+// frames come back through a ring of pixel buffer objects, software
+// frames are copied, and encoding and writing happen on worker threads.
+// When the encoders fall behind, frames are dropped and counted.
+class FrameCapture {
+    public:
+        FrameCapture();
+        ~FrameCapture();
+
+        // fps only goes in the Y4M header. With use_gl frames come from
+        // CaptureGL(), otherwise from CapturePixels().
+        bool Start(const char *path, int width, int height, int fps, bool use_gl);
+        // Queues a readback of the back buffer, call before swapping
+        void CaptureGL();
+        // Copies an RGBA8 frame, row 0 at the top
+        void CapturePixels(const uint32_t *pixels);
+        // Collects frames still in flight, lets the encoders finish and
+        // closes the output
+        void Stop();
+
+        bool IsActive() const { return active; }
+
+        // Frames presented while capturing, and those lost to a full queue
+        uint64_t captured;
+        uint64_t dropped;
+        std::atomic<uint64_t> written;
+
+    private:
+        struct Frame
+        {
+            std::vector<uint32_t> pixels;
+            uint64_t index;
+            // GL rows start at the bottom
+            bool bottom_up;
+        };
+
+        // A free frame from the pool, or NULL when the encoders are behind
+        Frame* AcquireFrame();
+        void Submit(Frame *frame);
+        // Maps the pixel buffer in slot and submits what it holds
+        void CollectReadback(int slot);
+        void WorkerLoop();
+        void WriteY4m(const Frame &frame);
+        void WritePng(const Frame &frame);
+
+        bool active;
+        bool use_gl;
+        CaptureFormat format;
+        std::string path;
+        int width, height, fps;
+        FILE *video;
+        // Scratch for the Y4M planes, only touched by its single worker
+        std::vector<unsigned char> planes;
+
+        GLuint pixel_buffers[CAPTURE_PBO_COUNT];
+        // Frame index read into each buffer, or -1 when it is empty
+        int64_t pending[CAPTURE_PBO_COUNT];
+        int next_slot;
+
+        std::vector<Frame> pool;
+        std::vector<Frame*> free_frames;
+        std::deque<Frame*> queue;
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        bool stopping;
+};
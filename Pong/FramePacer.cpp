@@ -0,0 +1,90 @@
+#include "FramePacer.h"
+#include "GameClock.h"
+#include <SDL.h>
+#include <time.h>
+
+// Seconds between two counter readings
+static double counter_seconds(uint64_t from, uint64_t to, uint64_t frequency)
+{
+    return (double) (to - from) / frequency;
+}
+
+FramePacer::FramePacer() : target_fps(0.0), vsync(false), pacing(false),
+                           frames(0), idle_waits(0),
+                           slept_seconds(0.0), spun_seconds(0.0), waited_seconds(0.0),
+                           frequency(1), frame_ticks(0), start_counter(0),
+                           next_deadline(0), start_cpu(0.0)
+{
+}
+
+void FramePacer::Start(double fps)
+{
+    target_fps = fps;
+    frequency = clock_frequency();
+    start_counter = clock_counter();
+    start_cpu = (double) clock() / CLOCKS_PER_SEC;
+
+    // With vsync on the swap already blocks, only sleep when the target is
+    // below the refresh rate
+    // No GL context means software rendering, which never waits for vsync
+    vsync = SDL_GL_GetCurrentContext() != NULL and SDL_GL_GetSwapInterval() != 0;
+    SDL_DisplayMode mode;
+    int refresh_rate = SDL_GetCurrentDisplayMode(0, &mode) == 0 ? mode.refresh_rate : 0;
+    pacing = target_fps > 0.0 and !(vsync and refresh_rate > 0 and target_fps >= refresh_rate);
+
+    frame_ticks = pacing ? (uint64_t) (frequency / target_fps) : 0;
+    next_deadline = start_counter + frame_ticks;
+}
+
+void FramePacer::EndFrame()
+{
+    frames++;
+    if (!pacing) { return; }
+
+    uint64_t now = clock_counter();
+    // Fell behind by more than a frame, start over from now instead of
+    // rushing to catch up
+    if ((int64_t) (now - next_deadline) > (int64_t) frame_ticks)
+    {
+        next_deadline = now + frame_ticks;
+        return;
+    }
+
+    // Sleep all but the tail
+    double remaining = counter_seconds(now, next_deadline, frequency);
+    if ((int64_t) (next_deadline - now) > 0 and remaining > SPIN_TAIL_SECONDS)
+    {
+        SDL_Delay((Uint32) ((remaining - SPIN_TAIL_SECONDS) * 1000.0));
+        uint64_t woke = clock_counter();
+        slept_seconds += counter_seconds(now, woke, frequency);
+        now = woke;
+    }
+
+    // Spin the rest
+    uint64_t spin_start = now;
+    while ((int64_t) (next_deadline - now) > 0) { now = clock_counter(); }
+    spun_seconds += counter_seconds(spin_start, now, frequency);
+
+    next_deadline += frame_ticks;
+}
+
+void FramePacer::WaitForEvent(int timeout_ms)
+{
+    uint64_t start = clock_counter();
+    SDL_WaitEventTimeout(NULL, timeout_ms);
+    uint64_t now = clock_counter();
+    waited_seconds += counter_seconds(start, now, frequency);
+    idle_waits++;
+    // Don't treat the wait as a late frame
+    next_deadline = now + frame_ticks;
+}
+
+double FramePacer::WallSeconds() const
+{
+    return counter_seconds(start_counter, clock_counter(), frequency);
+}
+
+double FramePacer::CpuSeconds() const
+{
+    return (double) clock() / CLOCKS_PER_SEC - start_cpu;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+// Frame rate the main loop is held to, --fps overrides it (0 = uncapped)
+const double DEFAULT_TARGET_FPS = 60.0;
+// Last stretch of a frame that is spun instead of slept, SDL_Delay() can
+// overshoot by a scheduler quantum
+const double SPIN_TAIL_SECONDS = 0.002;
+// How long the loop blocks waiting for input while nothing moves on screen
+const int IDLE_WAIT_MS = 250;
+
+// Keeps the main loop from running flat out. Sleeps away most of each frame
+// and spins the tail for precision, leaves pacing to the swap when vsync
+// already holds the loop at or below the target rate, and blocks on the
+// event queue while the game is idle.
+class FramePacer {
+    public:
+        FramePacer();
+
+        // target_fps of 0 disables the cap
+        void Start(double target_fps);
+
+        // Call once per frame after SDL_GL_SwapWindow()
+        void EndFrame();
+
+        // Blocks until an event arrives or timeout_ms passes. The event is
+        // left in the queue for process_input().
+        void WaitForEvent(int timeout_ms);
+
+        // Seconds since Start() on the wall clock and in process CPU time
+        double WallSeconds() const;
+        double CpuSeconds() const;
+
+        double target_fps;
+        bool vsync;
+        bool pacing;
+
+        // Where the time not spent working went
+        uint64_t frames;
+        uint64_t idle_waits;
+        double slept_seconds;
+        double spun_seconds;
+        double waited_seconds;
+
+    private:
+        uint64_t frequency;
+        uint64_t frame_ticks;
+        uint64_t start_counter;
+        uint64_t next_deadline;
+        double start_cpu;
+};
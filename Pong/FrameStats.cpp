@@ -0,0 +1,135 @@
+#include "FrameStats.h"
+#include "Logger.h"
+#include <stdio.h>
+#include <string.h>
+
+// Percentiles reported for every phase
+const double REPORTED_PERCENTILES[] = { 50.0, 99.0, 99.9 };
+
+// Bucket of a value: exact below 2^bits, then each power of two split
+// into HISTOGRAM_HALF_BUCKETS steps
+static int bucket_index(uint64_t value)
+{
+    if (value < (uint64_t) (2 * HISTOGRAM_HALF_BUCKETS)) { return (int) value; }
+    int top_bit = 63 - __builtin_clzll(value);
+    int shift = top_bit - HISTOGRAM_SUB_BUCKET_BITS + 1;
+    return shift * HISTOGRAM_HALF_BUCKETS + (int) (value >> shift);
+}
+
+// Largest value that lands in a bucket
+static uint64_t bucket_upper(int index)
+{
+    if (index < 2 * HISTOGRAM_HALF_BUCKETS) { return (uint64_t) index; }
+    int shift = index / HISTOGRAM_HALF_BUCKETS - 1;
+    uint64_t sub = (uint64_t) (index - shift * HISTOGRAM_HALF_BUCKETS);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Reset()
+{
+    memset(counts, 0, sizeof(counts));
+    count = 0;
+    total = 0;
+    max = 0;
+}
+
+void LatencyHistogram::Record(uint64_t nanoseconds)
+{
+    counts[bucket_index(nanoseconds)]++;
+    count++;
+    total += nanoseconds;
+    if (nanoseconds > max) { max = nanoseconds; }
+}
+
+uint64_t LatencyHistogram::ValueAtPercentile(double percentile) const
+{
+    if (count == 0) { return 0; }
+    uint64_t wanted = (uint64_t) (percentile / 100.0 * count + 0.5);
+    if (wanted < 1) { wanted = 1; }
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+    {
+        seen += counts[i];
+        if (seen >= wanted) { return bucket_upper(i) < max ? bucket_upper(i) : max; }
+    }
+    return max;
+}
+
+const char* frame_phase_name(FramePhase phase)
+{
+    switch (phase)
+    {
+        case PHASE_INPUT:   return "input";
+        case PHASE_UPDATE:  return "update";
+        case PHASE_RENDER:  return "render";
+        case PHASE_PRESENT: return "present";
+        case PHASE_SWAP:    return "swap";
+        case PHASE_PACING:  return "pacing";
+        case PHASE_IDLE:    return "idle";
+        case PHASE_FRAME:   return "frame";
+        default:            return "unknown";
+    }
+}
+
+FrameStats::FrameStats() : frequency(clock_frequency())
+{
+}
+
+void FrameStats::Reset()
+{
+    for (int p = 0; p < PHASE_COUNT; p++) { phases[p].Reset(); }
+}
+
+void FrameStats::Record(FramePhase phase, uint64_t counter_ticks)
+{
+    // Whole seconds and the remainder separately, so the product can't overflow
+    uint64_t nanoseconds = counter_ticks / frequency * 1000000000ull +
+                           counter_ticks % frequency * 1000000000ull / frequency;
+    phases[phase].Record(nanoseconds);
+}
+
+void FrameStats::Print() const
+{
+    LOG("phase        count     mean      p50      p99    p99.9      max  (ms)");
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        const LatencyHistogram &histogram = phases[p];
+        char line[128];
+        snprintf(line, sizeof(line), "%-8s %9llu %8.3f %8.3f %8.3f %8.3f %8.3f",
+                 frame_phase_name((FramePhase) p), (unsigned long long) histogram.Count(),
+                 histogram.Mean() / 1e6,
+                 histogram.ValueAtPercentile(REPORTED_PERCENTILES[0]) / 1e6,
+                 histogram.ValueAtPercentile(REPORTED_PERCENTILES[1]) / 1e6,
+                 histogram.ValueAtPercentile(REPORTED_PERCENTILES[2]) / 1e6,
+                 histogram.Max() / 1e6);
+        LOG(line);
+    }
+}
+
+bool FrameStats::WriteJson(const char *path) const
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        LOG_ERROR("Unable to write frame stats to " << path);
+        return false;
+    }
+    fprintf(file, "{\n  \"frames\": %llu,\n  \"unit\": \"ms\",\n  \"phases\": {\n",
+            (unsigned long long) phases[PHASE_FRAME].Count());
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        const LatencyHistogram &histogram = phases[p];
+        fprintf(file, "    \"%s\": { \"count\": %llu, \"mean\": %.6f, \"p50\": %.6f, \"p99\": %.6f, "
+                      "\"p99_9\": %.6f, \"max\": %.6f }%s\n",
+                frame_phase_name((FramePhase) p), (unsigned long long) histogram.Count(),
+                histogram.Mean() / 1e6,
+                histogram.ValueAtPercentile(REPORTED_PERCENTILES[0]) / 1e6,
+                histogram.ValueAtPercentile(REPORTED_PERCENTILES[1]) / 1e6,
+                histogram.ValueAtPercentile(REPORTED_PERCENTILES[2]) / 1e6,
+                histogram.Max() / 1e6,
+                p + 1 < PHASE_COUNT ? "," : "");
+    }
+    fprintf(file, "  }\n}\n");
+    fclose(file);
+    return true;
+}
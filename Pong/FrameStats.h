@@ -0,0 +1,85 @@
+#pragma once
+
+#include "GameClock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Values below 2^bits are exact; above, each power of two is split into
+// 2^(bits - 1) buckets, so a bucket's upper edge overstates what is in it
+// by under 1/128, about 0.8%
+const int HISTOGRAM_SUB_BUCKET_BITS = 8;
+const int HISTOGRAM_HALF_BUCKETS = 1 << (HISTOGRAM_SUB_BUCKET_BITS - 1);
+const int HISTOGRAM_BUCKETS = (64 - HISTOGRAM_SUB_BUCKET_BITS + 2) * HISTOGRAM_HALF_BUCKETS;
+
+// Log-linear histogram of durations in nanoseconds, in the style of
+// HdrHistogram: fixed memory, constant-time Record(), bounded relative error
+class LatencyHistogram {
+    public:
+        LatencyHistogram() { Reset(); }
+
+        void Reset();
+        void Record(uint64_t nanoseconds);
+
+        // Upper edge of the bucket holding the given percentile, 0 to 100
+        uint64_t ValueAtPercentile(double percentile) const;
+        uint64_t Max() const { return max; }
+        uint64_t Count() const { return count; }
+        double Mean() const { return count > 0 ? (double) total / count : 0.0; }
+
+    private:
+        uint64_t counts[HISTOGRAM_BUCKETS];
+        uint64_t count;
+        uint64_t total;
+        uint64_t max;
+};
+
+// Parts of the main loop that are timed. Swap is only SDL_GL_SwapWindow,
+// kept apart because it mostly waits on the GPU or vsync rather than
+// working. Present is the CPU work of getting the frame out besides that:
+// capture readbacks and the software blit. Pacing is the frame limiter's
+// sleep, idle the wait for input on still screens.
+enum FramePhase
+{
+    PHASE_INPUT,
+    PHASE_UPDATE,
+    PHASE_RENDER,
+    PHASE_PRESENT,
+    PHASE_SWAP,
+    PHASE_PACING,
+    PHASE_IDLE,
+    PHASE_FRAME,
+    PHASE_COUNT
+};
+
+const char* frame_phase_name(FramePhase phase);
+
+// One histogram per phase
+class FrameStats {
+    public:
+        FrameStats();
+
+        void Reset();
+        void Record(FramePhase phase, uint64_t counter_ticks);
+
+        // Table of percentiles per phase, through the log
+        void Print() const;
+        // Same numbers as JSON, returns false if the file can't be written
+        bool WriteJson(const char *path) const;
+
+        LatencyHistogram phases[PHASE_COUNT];
+
+    private:
+        uint64_t frequency;
+};
+
+// Times a scope into one phase
+class PhaseTimer {
+    public:
+        PhaseTimer(FrameStats &stats, FramePhase phase) : stats(stats), phase(phase), start(clock_counter()) {}
+        ~PhaseTimer() { stats.Record(phase, clock_counter() - start); }
+
+    private:
+        FrameStats &stats;
+        FramePhase phase;
+        uint64_t start;
+};
@@ -0,0 +1,177 @@
+#include "GLStateCache.h"
+#include "Logger.h"
+#include <string.h>
+
+static const char* const STATE_NAMES[GL_STATE_KINDS] = {
+    "program", "texture", "buffer", "vertex array", "attribute", "blend", "uniform"
+};
+
+GLStateCache::GLStateCache()
+{
+    ResetCounters();
+    Invalidate();
+}
+
+GLStateCache& gl_state()
+{
+    static GLStateCache cache;
+    return cache;
+}
+
+// True when the call has to reach GL; the caller then makes it, so the
+// kind is known from here on
+bool GLStateCache::Check(GLStateKind kind, bool unchanged)
+{
+    uint32_t bit = 1u << kind;
+    if ((known & bit) and unchanged)
+    {
+        saved[kind]++;
+        return false;
+    }
+    known |= bit;
+    issued[kind]++;
+    return true;
+}
+
+void GLStateCache::UseProgram(GLuint new_program)
+{
+    if (!Check(GL_STATE_PROGRAM, program == new_program)) { return; }
+    glUseProgram(new_program);
+    program = new_program;
+}
+
+void GLStateCache::BindTexture(GLuint new_texture)
+{
+    if (!Check(GL_STATE_TEXTURE, texture == new_texture)) { return; }
+    glBindTexture(GL_TEXTURE_2D, new_texture);
+    texture = new_texture;
+}
+
+void GLStateCache::BindArrayBuffer(GLuint new_buffer)
+{
+    if (!Check(GL_STATE_BUFFER, array_buffer == new_buffer)) { return; }
+    glBindBuffer(GL_ARRAY_BUFFER, new_buffer);
+    array_buffer = new_buffer;
+}
+
+void GLStateCache::BindVertexArray(GLuint new_vertex_array)
+{
+    if (!Check(GL_STATE_VERTEX_ARRAY, vertex_array == new_vertex_array)) { return; }
+    glBindVertexArray(new_vertex_array);
+    vertex_array = new_vertex_array;
+    known_attributes = 0;
+    attributes = 0;
+}
+
+void GLStateCache::EnableAttribute(GLuint location)
+{
+    if (location >= GL_STATE_MAX_ATTRIBUTES)
+    {
+        glEnableVertexAttribArray(location);
+        issued[GL_STATE_ATTRIBUTE]++;
+        return;
+    }
+    uint32_t bit = 1u << location;
+    if (!Check(GL_STATE_ATTRIBUTE, (known_attributes & attributes & bit) != 0)) { return; }
+    glEnableVertexAttribArray(location);
+    known_attributes |= bit;
+    attributes |= bit;
+}
+
+void GLStateCache::DisableAttribute(GLuint location)
+{
+    if (location >= GL_STATE_MAX_ATTRIBUTES)
+    {
+        glDisableVertexAttribArray(location);
+        issued[GL_STATE_ATTRIBUTE]++;
+        return;
+    }
+    uint32_t bit = 1u << location;
+    if (!Check(GL_STATE_ATTRIBUTE, (known_attributes & bit) and !(attributes & bit))) { return; }
+    glDisableVertexAttribArray(location);
+    known_attributes |= bit;
+    attributes &= ~bit;
+}
+
+void GLStateCache::SetAttributes(uint32_t mask)
+{
+    for (GLuint location = 0; location < GL_STATE_MAX_ATTRIBUTES; location++)
+    {
+        uint32_t bit = 1u << location;
+        if (mask & bit) { EnableAttribute(location); }
+        else if (known_attributes & attributes & bit) { DisableAttribute(location); }
+    }
+}
+
+void GLStateCache::SetBlend(bool enabled, GLenum source, GLenum destination)
+{
+    bool unchanged = blend == enabled and (!enabled or (blend_source == source and blend_destination == destination));
+    if (!Check(GL_STATE_BLEND, unchanged)) { return; }
+    if (enabled)
+    {
+        glEnable(GL_BLEND);
+        glBlendFunc(source, destination);
+    }
+    else { glDisable(GL_BLEND); }
+    blend = enabled;
+    blend_source = source;
+    blend_destination = destination;
+}
+
+void GLStateCache::CountUniform(bool was_saved)
+{
+    if (was_saved) { saved[GL_STATE_UNIFORM]++; }
+    else { issued[GL_STATE_UNIFORM]++; }
+}
+
+void GLStateCache::ForgetProgram(GLuint deleted)
+{
+    if (program == deleted) { known &= ~(1u << GL_STATE_PROGRAM); }
+}
+
+void GLStateCache::ForgetTexture(GLuint deleted)
+{
+    if (texture == deleted) { known &= ~(1u << GL_STATE_TEXTURE); }
+}
+
+void GLStateCache::ForgetBuffer(GLuint deleted)
+{
+    if (array_buffer == deleted) { known &= ~(1u << GL_STATE_BUFFER); }
+}
+
+void GLStateCache::ForgetVertexArray(GLuint deleted)
+{
+    if (vertex_array == deleted) { known &= ~(1u << GL_STATE_VERTEX_ARRAY); }
+}
+
+void GLStateCache::Invalidate()
+{
+    known = 0;
+    known_attributes = 0;
+    program = 0;
+    texture = 0;
+    array_buffer = 0;
+    vertex_array = 0;
+    attributes = 0;
+    blend = false;
+    blend_source = GL_ONE;
+    blend_destination = GL_ZERO;
+}
+
+void GLStateCache::ResetCounters()
+{
+    memset(issued, 0, sizeof(issued));
+    memset(saved, 0, sizeof(saved));
+}
+
+void GLStateCache::Print() const
+{
+    size_t total_issued = 0, total_saved = 0;
+    for (int kind = 0; kind < GL_STATE_KINDS; kind++)
+    {
+        LOG("GL " << STATE_NAMES[kind] << ": " << issued[kind] << " issued, " << saved[kind] << " skipped");
+        total_issued += issued[kind];
+        total_saved += saved[kind];
+    }
+    LOG("GL state calls: " << total_issued << " issued, " << total_saved << " skipped");
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Kinds of state the cache filters, for the counters
+enum GLStateKind
+{
+    GL_STATE_PROGRAM,
+    GL_STATE_TEXTURE,
+    GL_STATE_BUFFER,
+    GL_STATE_VERTEX_ARRAY,
+    GL_STATE_ATTRIBUTE,
+    GL_STATE_BLEND,
+    GL_STATE_UNIFORM,
+    GL_STATE_KINDS
+};
+
+// Attribute locations the cache tracks, higher ones go straight to GL
+const GLuint GL_STATE_MAX_ATTRIBUTES = 32;
+
+// Mirror of the GL state the game touches. Every setter compares against
+// the last value it sent and drops the call when nothing would change.
+// Code that changes state behind its back must call Invalidate().
+class GLStateCache {
+    public:
+        GLStateCache();
+
+        void UseProgram(GLuint program);
+        void BindTexture(GLuint texture);
+        void BindArrayBuffer(GLuint buffer);
+        // Attribute enables live in the vertex array, so changing it
+        // forgets them
+        void BindVertexArray(GLuint vertex_array);
+        void EnableAttribute(GLuint location);
+        void DisableAttribute(GLuint location);
+        // Enables the attributes in mask and disables the others it knows
+        // to be enabled; untouched locations are left to GL's default, off
+        void SetAttributes(uint32_t mask);
+        void SetBlend(bool enabled, GLenum source, GLenum destination);
+
+        // Called instead of the GL call when a redundant uniform upload is
+        // filtered elsewhere, or with saved false when one goes through
+        void CountUniform(bool saved);
+
+        // Objects about to be deleted, so a reused name is not mistaken as bound
+        void ForgetProgram(GLuint program);
+        void ForgetTexture(GLuint texture);
+        void ForgetBuffer(GLuint buffer);
+        void ForgetVertexArray(GLuint vertex_array);
+
+        // Forgets everything, the next call of each kind always reaches GL
+        void Invalidate();
+        void ResetCounters();
+        // Issued and skipped calls per kind
+        void Print() const;
+
+        size_t issued[GL_STATE_KINDS];
+        size_t saved[GL_STATE_KINDS];
+
+    private:
+        bool Check(GLStateKind kind, bool unchanged);
+
+        // Bit per GLStateKind whose value below matches GL
+        uint32_t known;
+        // Bit per attribute location whose enable state is known
+        uint32_t known_attributes;
+        GLuint program;
+        GLuint texture;
+        GLuint array_buffer;
+        GLuint vertex_array;
+        uint32_t attributes;
+        bool blend;
+        GLenum blend_source;
+        GLenum blend_destination;
+};
+
+// The cache for the one GL context the game creates
+GLStateCache& gl_state();
+
+// Mask bit for SetAttributes(), 0 for locations the cache doesn't track
+inline uint32_t attribute_bit(GLuint location)
+{
+    return location < GL_STATE_MAX_ATTRIBUTES ? 1u << location : 0;
+}
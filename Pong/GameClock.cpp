@@ -0,0 +1,98 @@
+#include "GameClock.h"
+#include <math.h>
+
+#ifdef POKEPONG_HEADLESS
+#include <time.h>
+#else
+#include <SDL.h>
+#endif
+
+uint64_t clock_counter()
+{
+#ifdef POKEPONG_HEADLESS
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ull + (uint64_t) now.tv_nsec;
+#else
+    return SDL_GetPerformanceCounter();
+#endif
+}
+
+uint64_t clock_frequency()
+{
+#ifdef POKEPONG_HEADLESS
+    return 1000000000ull;
+#else
+    return SDL_GetPerformanceFrequency();
+#endif
+}
+
+double wrap_degrees(double angle)
+{
+    angle = fmod(angle, 360.0);
+    if (angle < 0.0) { angle += 360.0; }
+    return angle;
+}
+
+GameClock::GameClock() : frequency(1), start_counter(0), last_counter(0),
+                         game_ticks(0), game_tick_remainder(0.0),
+                         time_scale(1.0), paused(false)
+{
+}
+
+void GameClock::Start()
+{
+    Start(clock_counter(), clock_frequency());
+}
+
+void GameClock::Start(uint64_t counter, uint64_t counter_frequency)
+{
+    frequency = counter_frequency > 0 ? counter_frequency : 1;
+    start_counter = counter;
+    last_counter = counter;
+    game_ticks = 0;
+    game_tick_remainder = 0.0;
+}
+
+double GameClock::Tick()
+{
+    return Advance(clock_counter());
+}
+
+double GameClock::Advance(uint64_t counter)
+{
+    // Unsigned difference, still right if the counter wrapped
+    uint64_t elapsed = counter - last_counter;
+    last_counter = counter;
+
+    uint64_t max_elapsed = (uint64_t) (MAX_CLOCK_DELTA * frequency);
+    if (elapsed > max_elapsed) { elapsed = max_elapsed; }
+    if (paused or time_scale <= 0.0) { return 0.0; }
+
+    // Whole ticks go into game time, the fraction waits for the next frame
+    double scaled = elapsed * time_scale + game_tick_remainder;
+    double whole = floor(scaled);
+    game_tick_remainder = scaled - whole;
+    game_ticks += (uint64_t) whole;
+    return whole / frequency;
+}
+
+void GameClock::SetTimeScale(double scale)
+{
+    time_scale = scale > 0.0 ? scale : 0.0;
+}
+
+void GameClock::SetPaused(bool pause)
+{
+    paused = pause;
+}
+
+double GameClock::RealSeconds() const
+{
+    return (double) (last_counter - start_counter) / frequency;
+}
+
+double GameClock::GameSeconds() const
+{
+    return (double) game_ticks / frequency;
+}
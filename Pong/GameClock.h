@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+
+// Largest delta handed out by Tick(), so a stall in the debugger or a
+// suspended machine doesn't arrive as one huge step
+const double MAX_CLOCK_DELTA = 0.25;
+
+// Raw monotonic counter: SDL_GetPerformanceCounter(), or clock_gettime()
+// in headless builds
+uint64_t clock_counter();
+uint64_t clock_frequency();
+
+// Puts an angle in degrees back into [0, 360)
+double wrap_degrees(double angle);
+
+// Monotonic game clock. Everything is kept as integer counter ticks, so a
+// delta is just as precise after weeks of uptime as right after start-up.
+// Doubles are only produced for the delta of one frame.
+class GameClock {
+    public:
+        GameClock();
+
+        // Starts counting from now
+        void Start();
+        // Same, from a given counter value and frequency (for soak tests)
+        void Start(uint64_t counter, uint64_t frequency);
+
+        // Reads the counter and returns the scaled seconds since the last
+        // call, 0 while paused
+        double Tick();
+        // Same, with the counter value supplied by the caller
+        double Advance(uint64_t counter);
+
+        void SetTimeScale(double scale);
+        double GetTimeScale() const { return time_scale; }
+        void SetPaused(bool paused);
+        bool IsPaused() const { return paused; }
+
+        // Unscaled seconds since Start(), including paused time
+        double RealSeconds() const;
+        // Scaled seconds the game has actually run
+        double GameSeconds() const;
+
+        uint64_t frequency;
+        uint64_t start_counter;
+        uint64_t last_counter;
+
+        // Game time in counter ticks, with the fraction a time scale leaves
+        // over carried to the next frame
+        uint64_t game_ticks;
+        double game_tick_remainder;
+
+    private:
+        double time_scale;
+        bool paused;
+};
@@ -0,0 +1,196 @@
+#include "Logger.h"
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+// How long the drain thread naps when the ring is empty
+const int LOG_DRAIN_IDLE_MS = 2;
+
+// One queued line. sequence tells producers and the consumer whose turn it is.
+struct LogSlot
+{
+    std::atomic<size_t> sequence;
+    LogLevel level;
+    size_t length;
+    char text[LOG_LINE_BYTES];
+};
+
+// Bounded many-producer, single-consumer queue. A producer claims a slot by
+// bumping enqueue_position and publishes it by advancing its sequence, so
+// neither side ever takes a lock.
+static LogSlot log_ring[LOG_RING_CAPACITY];
+static std::atomic<size_t> enqueue_position(0);
+static size_t dequeue_position = 0;
+
+static std::atomic<bool> log_running(false);
+// log_write() calls that may still push, so log_stop() can wait them out
+static std::atomic<int> log_writers(0);
+static std::atomic<uint64_t> dropped_lines(0);
+static LogSink log_sink = log_sink_stdio;
+static std::thread log_thread;
+
+static void ring_reset()
+{
+    for (size_t i = 0; i < LOG_RING_CAPACITY; i++) { log_ring[i].sequence.store(i, std::memory_order_relaxed); }
+    enqueue_position.store(0, std::memory_order_relaxed);
+    dequeue_position = 0;
+}
+
+static bool ring_push(LogLevel level, const char *text, size_t length)
+{
+    size_t position = enqueue_position.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        LogSlot &slot = log_ring[position & (LOG_RING_CAPACITY - 1)];
+        size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+        if (difference == 0)
+        {
+            if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                slot.level = level;
+                slot.length = length < LOG_LINE_BYTES ? length : LOG_LINE_BYTES;
+                memcpy(slot.text, text, slot.length);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        // Full, the consumer hasn't freed this slot yet
+        else if (difference < 0) { return false; }
+        else { position = enqueue_position.load(std::memory_order_relaxed); }
+    }
+}
+
+// Hands every published line to the sink, returns how many there were
+static size_t ring_drain()
+{
+    size_t drained = 0;
+    for (;;)
+    {
+        LogSlot &slot = log_ring[dequeue_position & (LOG_RING_CAPACITY - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_position + 1) { break; }
+        log_sink(slot.level, slot.text, slot.length);
+        slot.sequence.store(dequeue_position + LOG_RING_CAPACITY, std::memory_order_release);
+        dequeue_position++;
+        drained++;
+    }
+    return drained;
+}
+
+static void drain_loop()
+{
+    while (log_running.load(std::memory_order_acquire))
+    {
+        if (ring_drain() > 0) { fflush(stdout); }
+        else
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(LOG_DRAIN_IDLE_MS));
+        }
+    }
+    ring_drain();
+}
+
+void log_sink_stdio(LogLevel level, const char *text, size_t length)
+{
+    FILE *stream = level >= LOG_LEVEL_WARN ? stderr : stdout;
+    fwrite(text, 1, length, stream);
+    fputc('\n', stream);
+    if (level >= LOG_LEVEL_WARN) { fflush(stream); }
+}
+
+void log_start(LogSink sink)
+{
+    if (log_running.load()) { return; }
+    log_sink = sink;
+    ring_reset();
+    log_running.store(true, std::memory_order_release);
+    log_thread = std::thread(drain_loop);
+}
+
+void log_stop()
+{
+    if (!log_running.load()) { return; }
+    log_running.store(false);
+    log_thread.join();
+    // A writer that saw log_running before it went false may still be
+    // pushing; let it finish, then print what came after the last pass
+    while (log_writers.load() > 0) { std::this_thread::yield(); }
+    ring_drain();
+    fflush(stdout);
+}
+
+void log_write(LogLevel level, const char *text, size_t length)
+{
+    // Sequentially consistent with log_stop(): either it sees this writer
+    // and waits, or this writer sees it stopped and writes straight out
+    log_writers.fetch_add(1);
+    if (!log_running.load())
+    {
+        log_writers.fetch_sub(1);
+        log_sink(level, text, length);
+        return;
+    }
+    if (!ring_push(level, text, length)) { dropped_lines.fetch_add(1, std::memory_order_relaxed); }
+    log_writers.fetch_sub(1);
+}
+
+uint64_t log_dropped()
+{
+    return dropped_lines.load(std::memory_order_relaxed);
+}
+
+LogLine& LogLine::operator<<(const char *value)
+{
+    if (value == NULL) { value = "(null)"; }
+    size_t room = LOG_LINE_BYTES - 1 - length;
+    size_t count = strlen(value);
+    if (count > room) { count = room; }
+    memcpy(text + length, value, count);
+    length += count;
+    text[length] = '\0';
+    return *this;
+}
+
+LogLine& LogLine::operator<<(char value)
+{
+    char buffer[2] = { value, '\0' };
+    return *this << buffer;
+}
+
+LogLine& LogLine::operator<<(long long value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%lld", value);
+    return *this << buffer;
+}
+
+LogLine& LogLine::operator<<(unsigned long long value)
+{
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%llu", value);
+    return *this << buffer;
+}
+
+LogLine& LogLine::operator<<(double value)
+{
+    // Same look as std::cout's default
+    char buffer[32];
+    snprintf(buffer, sizeof(buffer), "%g", value);
+    return *this << buffer;
+}
+
+bool LogRateLimit::Allow(double interval_seconds, unsigned &skipped)
+{
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t next = next_allowed.load(std::memory_order_relaxed);
+    if (now < next or !next_allowed.compare_exchange_strong(next, now + (int64_t) (interval_seconds * 1e9)))
+    {
+        suppressed.fetch_add(1, std::memory_order_relaxed);
+        skipped = 0;
+        return false;
+    }
+    skipped = suppressed.exchange(0, std::memory_order_relaxed);
+    return true;
+}
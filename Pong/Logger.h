@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Severity of a log line
+enum LogLevel
+{
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO  = 1,
+    LOG_LEVEL_WARN  = 2,
+    LOG_LEVEL_ERROR = 3
+};
+
+// Lowest level compiled in, everything below becomes a no-op.
+// Build with -DPOKEPONG_LOG_LEVEL=0 to get debug lines back.
+#ifndef POKEPONG_LOG_LEVEL
+#define POKEPONG_LOG_LEVEL 1
+#endif
+
+// Longest line kept, longer ones are cut
+const size_t LOG_LINE_BYTES = 240;
+// Lines the ring holds before new ones are dropped, a power of two
+const size_t LOG_RING_CAPACITY = 1024;
+
+// Where drained lines go
+typedef void (*LogSink)(LogLevel level, const char *text, size_t length);
+
+// Writes info and debug to stdout, warnings and errors to stderr
+void log_sink_stdio(LogLevel level, const char *text, size_t length);
+
+// Starts the background thread that drains the ring into sink. Until this
+// is called, and after log_stop(), lines are written synchronously.
+void log_start(LogSink sink = log_sink_stdio);
+// Drains whatever is left and joins the thread
+void log_stop();
+
+// Queues one line without blocking, dropping it if the ring is full
+void log_write(LogLevel level, const char *text, size_t length);
+// Lines lost to a full ring since start-up
+uint64_t log_dropped();
+
+// Formats a line into a fixed buffer, so logging never allocates
+class LogLine {
+    public:
+        LogLine() : length(0) { text[0] = '\0'; }
+
+        LogLine& operator<<(const char *value);
+        LogLine& operator<<(const std::string &value) { return *this << value.c_str(); }
+        LogLine& operator<<(char value);
+        LogLine& operator<<(bool value) { return *this << (value ? "1" : "0"); }
+        LogLine& operator<<(int value) { return *this << (long long) value; }
+        LogLine& operator<<(unsigned value) { return *this << (unsigned long long) value; }
+        LogLine& operator<<(long value) { return *this << (long long) value; }
+        LogLine& operator<<(unsigned long value) { return *this << (unsigned long long) value; }
+        LogLine& operator<<(long long value);
+        LogLine& operator<<(unsigned long long value);
+        LogLine& operator<<(float value) { return *this << (double) value; }
+        LogLine& operator<<(double value);
+
+        char text[LOG_LINE_BYTES];
+        size_t length;
+};
+
+// Lets one line through per interval from a single call site and counts
+// the rest. Safe to share between threads.
+class LogRateLimit {
+    public:
+        LogRateLimit() : next_allowed(0), suppressed(0) {}
+
+        // True when the line should be written, skipped is how many were
+        // held back since the last one that was
+        bool Allow(double interval_seconds, unsigned &skipped);
+
+    private:
+        std::atomic<int64_t> next_allowed;
+        std::atomic<unsigned> suppressed;
+};
+
+#define POKEPONG_LOG_AT(level, argument) \
+    do { LogLine log_line_; log_line_ << argument; log_write(level, log_line_.text, log_line_.length); } while (0)
+
+#define POKEPONG_LOG_EVERY(level, seconds, argument) \
+    do { \
+        static LogRateLimit log_limit_; \
+        unsigned log_skipped_; \
+        if (log_limit_.Allow(seconds, log_skipped_)) \
+        { \
+            LogLine log_line_; \
+            log_line_ << argument; \
+            if (log_skipped_ > 0) { log_line_ << " (" << log_skipped_ << " suppressed)"; } \
+            log_write(level, log_line_.text, log_line_.length); \
+        } \
+    } while (0)
+
+#if POKEPONG_LOG_LEVEL <= 0
+#define LOG_DEBUG(argument) POKEPONG_LOG_AT(LOG_LEVEL_DEBUG, argument)
+#define LOG_DEBUG_EVERY(seconds, argument) POKEPONG_LOG_EVERY(LOG_LEVEL_DEBUG, seconds, argument)
+#else
+#define LOG_DEBUG(argument) ((void) 0)
+#define LOG_DEBUG_EVERY(seconds, argument) ((void) 0)
+#endif
+
+#if POKEPONG_LOG_LEVEL <= 1
+#define LOG_INFO(argument) POKEPONG_LOG_AT(LOG_LEVEL_INFO, argument)
+#define LOG_INFO_EVERY(seconds, argument) POKEPONG_LOG_EVERY(LOG_LEVEL_INFO, seconds, argument)
+#else
+#define LOG_INFO(argument) ((void) 0)
+#define LOG_INFO_EVERY(seconds, argument) ((void) 0)
+#endif
+
+#if POKEPONG_LOG_LEVEL <= 2
+#define LOG_WARN(argument) POKEPONG_LOG_AT(LOG_LEVEL_WARN, argument)
+#else
+#define LOG_WARN(argument) ((void) 0)
+#endif
+
+#if POKEPONG_LOG_LEVEL <= 3
+#define LOG_ERROR(argument) POKEPONG_LOG_AT(LOG_LEVEL_ERROR, argument)
+#else
+#define LOG_ERROR(argument) ((void) 0)
+#endif
+
+// The game's original macro, now an info line
+#define LOG(argument) LOG_INFO(argument)
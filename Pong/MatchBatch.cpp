@@ -0,0 +1,752 @@
+#include "MatchBatch.h"
+#include "Collision.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The kernels and step() only round alike if neither fuses a multiply and
+// an add, which compilers do by default on FMA targets such as arm64
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+// Number of per-match arrays carved out of the single allocation
+const size_t MATCH_BATCH_ARRAYS = 10;
+const size_t MATCH_BATCH_ALIGNMENT = 32;
+// Ball angles wrap back into [0, FULL_TURN) degrees
+const float FULL_TURN = 360.0f;
+
+MatchBatch::MatchBatch(size_t count) : count(count)
+{
+    padded_count = (count + MATCH_BATCH_LANES - 1) / MATCH_BATCH_LANES * MATCH_BATCH_LANES;
+    if (padded_count == 0) { padded_count = MATCH_BATCH_LANES; }
+    simd_level = detect_simd_level();
+
+    // One aligned block, every array starts on a 32-byte boundary because
+    // padded_count is a multiple of 8 four-byte lanes
+    size_t bytes = padded_count * sizeof(float) * MATCH_BATCH_ARRAYS;
+    storage = malloc(bytes + MATCH_BATCH_ALIGNMENT);
+    if (storage == NULL) { abort(); }
+    uintptr_t aligned = ((uintptr_t) storage + MATCH_BATCH_ALIGNMENT - 1) & ~(uintptr_t) (MATCH_BATCH_ALIGNMENT - 1);
+
+    float *floats = (float*) aligned;
+    position_left_pad_y  = floats + padded_count * 0;
+    position_right_pad_y = floats + padded_count * 1;
+    position_ball_x      = floats + padded_count * 2;
+    position_ball_y      = floats + padded_count * 3;
+    movement_ball_x      = floats + padded_count * 4;
+    movement_ball_y      = floats + padded_count * 5;
+    rot_angle            = floats + padded_count * 6;
+    end_game    = (int32_t*) (floats + padded_count * 7);
+    winner      = (int32_t*) (floats + padded_count * 8);
+    paddle_hits = (int32_t*) (floats + padded_count * 9);
+
+    for (size_t i = 0; i < padded_count; i++) { Reset(i); }
+    // Padding lanes never run
+    for (size_t i = count; i < padded_count; i++) { end_game[i] = -1; }
+}
+
+MatchBatch::~MatchBatch() { free(storage); }
+
+void MatchBatch::Reset(size_t i, const glm::vec3 &movement_ball)
+{
+    position_left_pad_y[i]  = 0.0f;
+    position_right_pad_y[i] = 0.0f;
+    position_ball_x[i]      = 0.0f;
+    position_ball_y[i]      = 0.0f;
+    movement_ball_x[i]      = movement_ball.x;
+    movement_ball_y[i]      = movement_ball.y;
+    rot_angle[i]   = 0.0f;
+    end_game[i]    = 0;
+    winner[i]      = 0;
+    paddle_hits[i] = 0;
+}
+
+void MatchBatch::Load(size_t i, const MatchState &state)
+{
+    position_left_pad_y[i]  = state.position_left_pad.y;
+    position_right_pad_y[i] = state.position_right_pad.y;
+    position_ball_x[i]      = state.position_ball.x;
+    position_ball_y[i]      = state.position_ball.y;
+    movement_ball_x[i]      = state.movement_ball.x;
+    movement_ball_y[i]      = state.movement_ball.y;
+    rot_angle[i]   = state.rot_angle;
+    end_game[i]    = state.end_game ? -1 : 0;
+    winner[i]      = state.winner;
+    paddle_hits[i] = state.paddle_hits;
+}
+
+void MatchBatch::Store(size_t i, MatchState &state) const
+{
+    state.position_left_pad  = glm::vec3(0.0f, position_left_pad_y[i], 0.0f);
+    state.position_right_pad = glm::vec3(0.0f, position_right_pad_y[i], 0.0f);
+    state.position_ball      = glm::vec3(position_ball_x[i], position_ball_y[i], 0.0f);
+    state.movement_ball      = glm::vec3(movement_ball_x[i], movement_ball_y[i], 0.0f);
+    state.rot_angle   = rot_angle[i];
+    state.end_game    = end_game[i] != 0;
+    state.winner      = winner[i];
+    state.paddle_hits = paddle_hits[i];
+}
+
+// Constants shared by every kernel. Each one is computed with the same
+// expression as step() in Simulation.cpp so all kernels match it bit for bit.
+struct StepConstants
+{
+    float pad_step_scale;       // SPEED_PAD, multiplied by the input then delta_time
+    float ball_step_scale;      // SPEED_BALL, multiplied by the movement then delta_time times the rest of the step
+    float rot_step;
+    float pad_bound;
+    float goal_bound;           // ball centre against the left and right edges
+    float wall_bound;           // ball centre against the top and bottom edges
+    float ball_half_x, ball_half_y;
+    float pad_half_x, pad_half_y;
+    float extent_x, extent_y;   // half sizes of ball and paddle added, as swept_aabb() does
+    float left_pad_x, left_pad_y;
+    float right_pad_x, right_pad_y;
+    float ball_x, ball_y;
+};
+
+static StepConstants make_constants(float delta_time)
+{
+    StepConstants c;
+    c.pad_step_scale  = SPEED_PAD;
+    c.ball_step_scale = SPEED_BALL;
+    c.rot_step    = ROT_SPEED_BALL * delta_time;
+    c.pad_bound   = FIELD_HALF_HEIGHT - 0.5f * SIZE_PADDLE.y;
+    c.goal_bound  = FIELD_HALF_WIDTH - 0.5f * SIZE_BALL.x;
+    c.wall_bound  = FIELD_HALF_HEIGHT - 0.5f * SIZE_BALL.y;
+    c.ball_half_x = 0.5f * SIZE_BALL.x;
+    c.ball_half_y = 0.5f * SIZE_BALL.y;
+    c.pad_half_x  = 0.5f * SIZE_PADDLE.x;
+    c.pad_half_y  = 0.5f * SIZE_PADDLE.y;
+    c.extent_x    = c.ball_half_x + c.pad_half_x;
+    c.extent_y    = c.ball_half_y + c.pad_half_y;
+    // Paddles never move in x, so their x offset is always 0
+    c.left_pad_x  = INIT_POSITION_LEFT_PAD.x + 0.0f;
+    c.left_pad_y  = INIT_POSITION_LEFT_PAD.y;
+    c.right_pad_x = INIT_POSITION_RIGHT_PAD.x + 0.0f;
+    c.right_pad_y = INIT_POSITION_RIGHT_PAD.y;
+    c.ball_x = INIT_POSITION_BALL.x;
+    c.ball_y = INIT_POSITION_BALL.y;
+    return c;
+}
+
+// Every kernel walks a step the way step() does: the paddles slide first,
+// then the ball goes from contact to contact, at most MAX_EVENTS_PER_STEP
+// times. Each pass takes the earliest of goal, wall, left and right paddle,
+// with the same ties as next_ball_event(), moves the ball up to it and
+// reflects. The SIMD kernels run the passes until every lane is done and
+// mask off the lanes that finished early.
+
+// Paddle position after sliding for a step, stopped at the wall
+static inline float slide_paddle_scalar(float init_y, float position_y, float input,
+                                        float delta_time, const StepConstants &c)
+{
+    float y = init_y + position_y + input * c.pad_step_scale * delta_time;
+    y = fmaxf(-c.pad_bound, fminf(c.pad_bound, y));
+    return y - init_y;
+}
+
+// Time of impact with the line at +-bound, like wall_time() in Simulation.cpp
+static inline bool wall_time_scalar(float position, float move, float bound, float &time)
+{
+    if (move == 0.0f) { return false; }
+    float target = move > 0.0f ? bound : -bound;
+    time = (target - position) / move;
+    if (time > 1.0f) { return false; }
+    if (time < 0.0f) { time = 0.0f; }
+    return true;
+}
+
+// Contact with one paddle as next_ball_event() resolves it. Returns false
+// when there is none or the ball is already on its way out.
+static inline bool paddle_contact_scalar(float ball_x, float ball_y, float move_x, float move_y,
+                                         float movement_x, float movement_y,
+                                         float pad_x, float pad_y, float pad_move_y,
+                                         const StepConstants &c, SweptHit &hit)
+{
+    Aabb ball_box = { ball_x, ball_y, c.ball_half_x, c.ball_half_y };
+    Aabb pad_box = { pad_x, pad_y, c.pad_half_x, c.pad_half_y };
+    if (!swept_aabb(ball_box, move_x, move_y, pad_box, 0.0f, pad_move_y, hit)) { return false; }
+    // Caught inside, leave through the side
+    if (hit.started_inside)
+    {
+        hit.normal_x = ball_x < pad_x ? -1.0f : 1.0f;
+        hit.normal_y = 0.0f;
+    }
+    // Run over from above or below, pushed out through the side
+    bool heading_away = hit.normal_x * movement_x + hit.normal_y * movement_y > 0.0f;
+    if (heading_away and hit.normal_y != 0.0f)
+    {
+        float contact_x = ball_x + move_x * hit.time;
+        hit.normal_x = contact_x < pad_x ? -1.0f : 1.0f;
+        hit.normal_y = 0.0f;
+        heading_away = hit.normal_x * movement_x > 0.0f;
+    }
+    return !heading_away;
+}
+
+// Contacts the ball can make, as in Simulation.cpp
+enum BatchEvent { BATCH_NONE, BATCH_GOAL, BATCH_WALL, BATCH_PADDLE };
+
+// One match at a time, for CPUs without SSE2
+static void step_scalar(MatchBatch &b, const float *left_input, const float *right_input,
+                        float delta_time, const StepConstants &c)
+{
+    for (size_t i = 0; i < b.padded_count; i++)
+    {
+        if (b.end_game[i]) { continue; }
+
+        // Paddles
+        float left_start = c.left_pad_y + b.position_left_pad_y[i];
+        float right_start = c.right_pad_y + b.position_right_pad_y[i];
+        b.position_left_pad_y[i] = slide_paddle_scalar(c.left_pad_y, b.position_left_pad_y[i], left_input[i], delta_time, c);
+        b.position_right_pad_y[i] = slide_paddle_scalar(c.right_pad_y, b.position_right_pad_y[i], right_input[i], delta_time, c);
+        float left_step = c.left_pad_y + b.position_left_pad_y[i] - left_start;
+        float right_step = c.right_pad_y + b.position_right_pad_y[i] - right_start;
+
+        // Ball
+        float ball_x = c.ball_x + b.position_ball_x[i];
+        float ball_y = c.ball_y + b.position_ball_y[i];
+        float &movement_x = b.movement_ball_x[i];
+        float &movement_y = b.movement_ball_y[i];
+        float elapsed = 0.0f;
+        for (int event = 0; event < MAX_EVENTS_PER_STEP and elapsed < 1.0f; event++)
+        {
+            float remaining = 1.0f - elapsed;
+            float scale = delta_time * remaining;
+            float move_x = movement_x * c.ball_step_scale * scale;
+            float move_y = movement_y * c.ball_step_scale * scale;
+
+            float first_time = 1.0f;
+            BatchEvent first = BATCH_NONE;
+            SweptHit first_hit = { 1.0f, 0.0f, 0.0f, false };
+            float time;
+            if (wall_time_scalar(ball_x, move_x, c.goal_bound, time) and time <= first_time)
+            { first_time = time; first = BATCH_GOAL; }
+            if (wall_time_scalar(ball_y, move_y, c.wall_bound, time) and time < first_time)
+            { first_time = time; first = BATCH_WALL; }
+            SweptHit hit;
+            if (paddle_contact_scalar(ball_x, ball_y, move_x, move_y, movement_x, movement_y,
+                                      c.left_pad_x, left_start + left_step * elapsed, left_step * remaining, c, hit) and
+                hit.time < first_time)
+            { first_time = hit.time; first = BATCH_PADDLE; first_hit = hit; }
+            if (paddle_contact_scalar(ball_x, ball_y, move_x, move_y, movement_x, movement_y,
+                                      c.right_pad_x, right_start + right_step * elapsed, right_step * remaining, c, hit) and
+                hit.time < first_time)
+            { first_time = hit.time; first = BATCH_PADDLE; first_hit = hit; }
+
+            // Move up to the contact
+            ball_x += move_x * first_time;
+            ball_y += move_y * first_time;
+            elapsed += remaining * first_time;
+
+            if (first == BATCH_NONE) { break; }
+            if (first == BATCH_GOAL)
+            {
+                b.end_game[i] = -1;
+                b.winner[i] = ball_x < 0 ? 2 : 1;
+                break;
+            }
+            if (first == BATCH_WALL) { movement_y = -movement_y; }
+            else
+            {
+                if (first_hit.normal_x != 0.0f) { movement_x = fabsf(movement_x) * first_hit.normal_x; }
+                else { movement_y = fabsf(movement_y) * first_hit.normal_y; }
+                b.paddle_hits[i]++;
+            }
+        }
+        b.position_ball_x[i] = ball_x - c.ball_x;
+        b.position_ball_y[i] = ball_y - c.ball_y;
+        // One turn at most per step, and x - 360 is exact for x in
+        // [360, 720), so this matches wrap_degrees() bit for bit
+        float rot = b.rot_angle[i] + c.rot_step;
+        b.rot_angle[i] = rot >= FULL_TURN ? rot - FULL_TURN : rot;
+    }
+}
+
+#ifdef __SSE2__
+
+static inline __m128 blend_sse2(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// First contact found so far in a pass, per lane. goal, wall and paddle
+// are masks, at most one of them set.
+struct ContactSse2
+{
+    __m128 time;
+    __m128 goal, wall, paddle;
+    __m128 normal_x, normal_y;
+};
+
+// New offset of four paddles, lanes that aren't active keep theirs
+static inline __m128 slide_paddle_sse2(float *position, const float *input, __m128 active,
+                                       __m128 scale, __m128 dt, __m128 init_y, __m128 bound)
+{
+    __m128 old_y = _mm_load_ps(position);
+    __m128 y = _mm_add_ps(_mm_add_ps(init_y, old_y), _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(input), scale), dt));
+    y = _mm_max_ps(_mm_xor_ps(bound, _mm_set1_ps(-0.0f)), _mm_min_ps(bound, y));
+    __m128 new_y = blend_sse2(active, _mm_sub_ps(y, init_y), old_y);
+    _mm_store_ps(position, new_y);
+    return new_y;
+}
+
+// wall_time() for four lanes, valid is set where there is a contact
+static inline __m128 wall_time_sse2(__m128 position, __m128 move, __m128 bound, __m128 &valid)
+{
+    const __m128 zero = _mm_setzero_ps();
+    __m128 target = blend_sse2(_mm_cmpgt_ps(move, zero), bound, _mm_xor_ps(bound, _mm_set1_ps(-0.0f)));
+    __m128 time = _mm_div_ps(_mm_sub_ps(target, position), move);
+    valid = _mm_and_ps(_mm_cmpneq_ps(move, zero), _mm_cmple_ps(time, _mm_set1_ps(1.0f)));
+    return blend_sse2(_mm_cmplt_ps(time, zero), zero, time);
+}
+
+// slab_times() in Collision.cpp for four lanes
+static inline __m128 slab_times_sse2(__m128 position, __m128 move, __m128 extent,
+                                     __m128 &entry, __m128 &exit)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 infinity = _mm_set1_ps(INFINITY);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    __m128 still = _mm_cmpeq_ps(move, zero);
+    __m128 t1 = _mm_div_ps(_mm_sub_ps(_mm_xor_ps(extent, _mm_set1_ps(-0.0f)), position), move);
+    __m128 t2 = _mm_div_ps(_mm_sub_ps(extent, position), move);
+    entry = blend_sse2(still, _mm_xor_ps(infinity, _mm_set1_ps(-0.0f)), _mm_min_ps(t1, t2));
+    exit = blend_sse2(still, infinity, _mm_max_ps(t1, t2));
+    return _mm_or_ps(_mm_cmpneq_ps(move, zero), _mm_cmplt_ps(_mm_and_ps(position, abs_mask), extent));
+}
+
+// paddle_contact_scalar() for four lanes, taking the contact into first
+// where it comes strictly earlier
+static inline void paddle_contact_sse2(__m128 ball_x, __m128 ball_y, __m128 move_x, __m128 move_y,
+                                       __m128 movement_x, __m128 movement_y,
+                                       __m128 pad_x, __m128 pad_y, __m128 pad_move_y,
+                                       __m128 extent_x, __m128 extent_y, ContactSse2 &first)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f), minus_one = _mm_set1_ps(-1.0f);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+    // swept_aabb() in the paddle's frame, which only moves in y
+    __m128 position_x = _mm_sub_ps(ball_x, pad_x);
+    __m128 position_y = _mm_sub_ps(ball_y, pad_y);
+    __m128 relative_y = _mm_sub_ps(move_y, pad_move_y);
+    __m128 entry_x, exit_x, entry_y, exit_y;
+    __m128 hit = _mm_and_ps(slab_times_sse2(position_x, move_x, extent_x, entry_x, exit_x),
+                            slab_times_sse2(position_y, relative_y, extent_y, entry_y, exit_y));
+    __m128 entry = _mm_max_ps(entry_x, entry_y);
+    __m128 exit = _mm_min_ps(exit_x, exit_y);
+    hit = _mm_and_ps(hit, _mm_and_ps(_mm_cmplt_ps(entry, exit),
+                                     _mm_and_ps(_mm_cmpgt_ps(exit, zero), _mm_cmple_ps(entry, one))));
+
+    // The face entered last, or for a ball already inside the side it is
+    // on, as long as it is still closing in on the shallower axis
+    __m128 inside = _mm_cmplt_ps(entry, zero);
+    __m128 x_face = _mm_cmpgt_ps(entry_x, entry_y);
+    __m128 normal_x = _mm_and_ps(x_face, blend_sse2(_mm_cmpgt_ps(move_x, zero), minus_one, one));
+    __m128 normal_y = _mm_andnot_ps(x_face, blend_sse2(_mm_cmpgt_ps(relative_y, zero), minus_one, one));
+    __m128 along_x = _mm_cmplt_ps(_mm_sub_ps(extent_x, _mm_and_ps(position_x, abs_mask)),
+                                  _mm_sub_ps(extent_y, _mm_and_ps(position_y, abs_mask)));
+    __m128 closing = blend_sse2(along_x, _mm_mul_ps(position_x, move_x), _mm_mul_ps(position_y, relative_y));
+    hit = _mm_andnot_ps(_mm_and_ps(inside, _mm_cmpge_ps(closing, zero)), hit);
+    __m128 time = _mm_andnot_ps(inside, entry);
+    __m128 side_x = blend_sse2(_mm_cmplt_ps(ball_x, pad_x), minus_one, one);
+    normal_x = blend_sse2(inside, side_x, normal_x);
+    normal_y = _mm_andnot_ps(inside, normal_y);
+
+    // Run over from above or below, pushed out through the side
+    __m128 heading_away = _mm_cmpgt_ps(_mm_add_ps(_mm_mul_ps(normal_x, movement_x),
+                                                  _mm_mul_ps(normal_y, movement_y)), zero);
+    __m128 pushed = _mm_and_ps(heading_away, _mm_cmpneq_ps(normal_y, zero));
+    __m128 contact_x = _mm_add_ps(ball_x, _mm_mul_ps(move_x, time));
+    __m128 pushed_x = blend_sse2(_mm_cmplt_ps(contact_x, pad_x), minus_one, one);
+    normal_x = blend_sse2(pushed, pushed_x, normal_x);
+    normal_y = _mm_andnot_ps(pushed, normal_y);
+    heading_away = blend_sse2(pushed, _mm_cmpgt_ps(_mm_mul_ps(pushed_x, movement_x), zero), heading_away);
+
+    __m128 earlier = _mm_and_ps(_mm_andnot_ps(heading_away, hit), _mm_cmplt_ps(time, first.time));
+    first.time = blend_sse2(earlier, time, first.time);
+    first.goal = _mm_andnot_ps(earlier, first.goal);
+    first.wall = _mm_andnot_ps(earlier, first.wall);
+    first.paddle = _mm_or_ps(first.paddle, earlier);
+    first.normal_x = blend_sse2(earlier, normal_x, first.normal_x);
+    first.normal_y = blend_sse2(earlier, normal_y, first.normal_y);
+}
+
+// Four matches per iteration
+static void step_sse2(MatchBatch &b, const float *left_input, const float *right_input,
+                      float delta_time, const StepConstants &c)
+{
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 dt = _mm_set1_ps(delta_time);
+    const __m128 pad_scale = _mm_set1_ps(c.pad_step_scale);
+    const __m128 ball_scale = _mm_set1_ps(c.ball_step_scale);
+    const __m128 rot_step = _mm_set1_ps(c.rot_step);
+    const __m128 full_turn = _mm_set1_ps(FULL_TURN);
+    const __m128 pad_bound = _mm_set1_ps(c.pad_bound);
+    const __m128 goal_bound = _mm_set1_ps(c.goal_bound);
+    const __m128 wall_bound = _mm_set1_ps(c.wall_bound);
+    const __m128 extent_x = _mm_set1_ps(c.extent_x);
+    const __m128 extent_y = _mm_set1_ps(c.extent_y);
+    const __m128 left_x = _mm_set1_ps(c.left_pad_x), left_init_y = _mm_set1_ps(c.left_pad_y);
+    const __m128 right_x = _mm_set1_ps(c.right_pad_x), right_init_y = _mm_set1_ps(c.right_pad_y);
+    const __m128 ball_init_x = _mm_set1_ps(c.ball_x), ball_init_y = _mm_set1_ps(c.ball_y);
+    const __m128i one_i = _mm_set1_epi32(1), two_i = _mm_set1_epi32(2);
+
+    for (size_t i = 0; i < b.padded_count; i += 4)
+    {
+        __m128i ended = _mm_load_si128((const __m128i*) (b.end_game + i));
+        __m128 active = _mm_castsi128_ps(_mm_cmpeq_epi32(ended, _mm_setzero_si128()));
+        if (_mm_movemask_ps(active) == 0) { continue; }
+
+        // Paddles
+        __m128 left_start = _mm_add_ps(left_init_y, _mm_load_ps(b.position_left_pad_y + i));
+        __m128 right_start = _mm_add_ps(right_init_y, _mm_load_ps(b.position_right_pad_y + i));
+        __m128 left_y = slide_paddle_sse2(b.position_left_pad_y + i, left_input + i, active,
+                                          pad_scale, dt, left_init_y, pad_bound);
+        __m128 right_y = slide_paddle_sse2(b.position_right_pad_y + i, right_input + i, active,
+                                           pad_scale, dt, right_init_y, pad_bound);
+        __m128 left_step = _mm_sub_ps(_mm_add_ps(left_init_y, left_y), left_start);
+        __m128 right_step = _mm_sub_ps(_mm_add_ps(right_init_y, right_y), right_start);
+
+        // Ball
+        __m128 old_x = _mm_load_ps(b.position_ball_x + i);
+        __m128 old_y = _mm_load_ps(b.position_ball_y + i);
+        __m128 ball_x = _mm_add_ps(ball_init_x, old_x);
+        __m128 ball_y = _mm_add_ps(ball_init_y, old_y);
+        __m128 movement_x = _mm_load_ps(b.movement_ball_x + i);
+        __m128 movement_y = _mm_load_ps(b.movement_ball_y + i);
+        __m128i winner = _mm_load_si128((const __m128i*) (b.winner + i));
+        __m128i hits = _mm_load_si128((const __m128i*) (b.paddle_hits + i));
+        __m128 elapsed = zero;
+        __m128 stepping = active;
+        for (int event = 0; event < MAX_EVENTS_PER_STEP; event++)
+        {
+            stepping = _mm_and_ps(stepping, _mm_cmplt_ps(elapsed, one));
+            if (_mm_movemask_ps(stepping) == 0) { break; }
+
+            __m128 remaining = _mm_sub_ps(one, elapsed);
+            __m128 scale = _mm_mul_ps(dt, remaining);
+            __m128 move_x = _mm_mul_ps(_mm_mul_ps(movement_x, ball_scale), scale);
+            __m128 move_y = _mm_mul_ps(_mm_mul_ps(movement_y, ball_scale), scale);
+
+            ContactSse2 first;
+            __m128 valid;
+            __m128 time = wall_time_sse2(ball_x, move_x, goal_bound, valid);
+            first.goal = _mm_and_ps(valid, _mm_cmple_ps(time, one));
+            first.time = blend_sse2(first.goal, time, one);
+            time = wall_time_sse2(ball_y, move_y, wall_bound, valid);
+            first.wall = _mm_and_ps(valid, _mm_cmplt_ps(time, first.time));
+            first.time = blend_sse2(first.wall, time, first.time);
+            first.goal = _mm_andnot_ps(first.wall, first.goal);
+            first.paddle = zero;
+            first.normal_x = zero;
+            first.normal_y = zero;
+            paddle_contact_sse2(ball_x, ball_y, move_x, move_y, movement_x, movement_y,
+                                left_x, _mm_add_ps(left_start, _mm_mul_ps(left_step, elapsed)),
+                                _mm_mul_ps(left_step, remaining), extent_x, extent_y, first);
+            paddle_contact_sse2(ball_x, ball_y, move_x, move_y, movement_x, movement_y,
+                                right_x, _mm_add_ps(right_start, _mm_mul_ps(right_step, elapsed)),
+                                _mm_mul_ps(right_step, remaining), extent_x, extent_y, first);
+
+            // Move up to the contact
+            ball_x = blend_sse2(stepping, _mm_add_ps(ball_x, _mm_mul_ps(move_x, first.time)), ball_x);
+            ball_y = blend_sse2(stepping, _mm_add_ps(ball_y, _mm_mul_ps(move_y, first.time)), ball_y);
+            elapsed = blend_sse2(stepping, _mm_add_ps(elapsed, _mm_mul_ps(remaining, first.time)), elapsed);
+
+            __m128 scored = _mm_and_ps(stepping, first.goal);
+            __m128 bounced = _mm_and_ps(stepping, first.wall);
+            __m128 reflected = _mm_and_ps(stepping, first.paddle);
+            __m128 side_face = _mm_cmpneq_ps(first.normal_x, zero);
+
+            __m128i left_won = _mm_castps_si128(_mm_cmplt_ps(ball_x, zero));
+            __m128i side = _mm_or_si128(_mm_and_si128(left_won, two_i), _mm_andnot_si128(left_won, one_i));
+            winner = _mm_or_si128(_mm_and_si128(_mm_castps_si128(scored), side),
+                                  _mm_andnot_si128(_mm_castps_si128(scored), winner));
+            ended = _mm_or_si128(ended, _mm_castps_si128(scored));
+            movement_y = _mm_xor_ps(movement_y, _mm_and_ps(bounced, sign));
+            movement_x = blend_sse2(_mm_and_ps(reflected, side_face),
+                                    _mm_mul_ps(_mm_and_ps(movement_x, abs_mask), first.normal_x), movement_x);
+            movement_y = blend_sse2(_mm_andnot_ps(side_face, reflected),
+                                    _mm_mul_ps(_mm_and_ps(movement_y, abs_mask), first.normal_y), movement_y);
+            hits = _mm_sub_epi32(hits, _mm_castps_si128(reflected));
+
+            // Lanes that scored or met nothing are done
+            stepping = _mm_and_ps(stepping, _mm_or_ps(bounced, reflected));
+        }
+
+        _mm_store_ps(b.position_ball_x + i, blend_sse2(active, _mm_sub_ps(ball_x, ball_init_x), old_x));
+        _mm_store_ps(b.position_ball_y + i, blend_sse2(active, _mm_sub_ps(ball_y, ball_init_y), old_y));
+        _mm_store_ps(b.movement_ball_x + i, movement_x);
+        _mm_store_ps(b.movement_ball_y + i, movement_y);
+        __m128 rot = _mm_load_ps(b.rot_angle + i);
+        __m128 turned = _mm_add_ps(rot, rot_step);
+        turned = _mm_sub_ps(turned, _mm_and_ps(_mm_cmpge_ps(turned, full_turn), full_turn));
+        _mm_store_ps(b.rot_angle + i, blend_sse2(active, turned, rot));
+
+        _mm_store_si128((__m128i*) (b.winner + i), winner);
+        _mm_store_si128((__m128i*) (b.end_game + i), ended);
+        _mm_store_si128((__m128i*) (b.paddle_hits + i), hits);
+    }
+}
+
+#endif
+
+#ifdef POKEPONG_X86_DISPATCH
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+// Same as ContactSse2, eight lanes
+struct ContactAvx2
+{
+    __m256 time;
+    __m256 goal, wall, paddle;
+    __m256 normal_x, normal_y;
+};
+
+AVX2_FUNCTION static inline __m256 slide_paddle_avx2(float *position, const float *input, __m256 active,
+                                                     __m256 scale, __m256 dt, __m256 init_y, __m256 bound)
+{
+    __m256 old_y = _mm256_load_ps(position);
+    __m256 y = _mm256_add_ps(_mm256_add_ps(init_y, old_y),
+                             _mm256_mul_ps(_mm256_mul_ps(_mm256_loadu_ps(input), scale), dt));
+    y = _mm256_max_ps(_mm256_xor_ps(bound, _mm256_set1_ps(-0.0f)), _mm256_min_ps(bound, y));
+    __m256 new_y = _mm256_blendv_ps(old_y, _mm256_sub_ps(y, init_y), active);
+    _mm256_store_ps(position, new_y);
+    return new_y;
+}
+
+AVX2_FUNCTION static inline __m256 wall_time_avx2(__m256 position, __m256 move, __m256 bound, __m256 &valid)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    __m256 target = _mm256_blendv_ps(_mm256_xor_ps(bound, _mm256_set1_ps(-0.0f)), bound,
+                                     _mm256_cmp_ps(move, zero, _CMP_GT_OQ));
+    __m256 time = _mm256_div_ps(_mm256_sub_ps(target, position), move);
+    valid = _mm256_and_ps(_mm256_cmp_ps(move, zero, _CMP_NEQ_OQ),
+                          _mm256_cmp_ps(time, _mm256_set1_ps(1.0f), _CMP_LE_OQ));
+    return _mm256_blendv_ps(time, zero, _mm256_cmp_ps(time, zero, _CMP_LT_OQ));
+}
+
+AVX2_FUNCTION static inline __m256 slab_times_avx2(__m256 position, __m256 move, __m256 extent,
+                                                   __m256 &entry, __m256 &exit)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 infinity = _mm256_set1_ps(INFINITY);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m256 still = _mm256_cmp_ps(move, zero, _CMP_EQ_OQ);
+    __m256 t1 = _mm256_div_ps(_mm256_sub_ps(_mm256_xor_ps(extent, _mm256_set1_ps(-0.0f)), position), move);
+    __m256 t2 = _mm256_div_ps(_mm256_sub_ps(extent, position), move);
+    entry = _mm256_blendv_ps(_mm256_min_ps(t1, t2), _mm256_xor_ps(infinity, _mm256_set1_ps(-0.0f)), still);
+    exit = _mm256_blendv_ps(_mm256_max_ps(t1, t2), infinity, still);
+    return _mm256_or_ps(_mm256_cmp_ps(move, zero, _CMP_NEQ_OQ),
+                        _mm256_cmp_ps(_mm256_and_ps(position, abs_mask), extent, _CMP_LT_OQ));
+}
+
+AVX2_FUNCTION static inline void paddle_contact_avx2(__m256 ball_x, __m256 ball_y, __m256 move_x, __m256 move_y,
+                                                     __m256 movement_x, __m256 movement_y,
+                                                     __m256 pad_x, __m256 pad_y, __m256 pad_move_y,
+                                                     __m256 extent_x, __m256 extent_y, ContactAvx2 &first)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f), minus_one = _mm256_set1_ps(-1.0f);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+
+    __m256 position_x = _mm256_sub_ps(ball_x, pad_x);
+    __m256 position_y = _mm256_sub_ps(ball_y, pad_y);
+    __m256 relative_y = _mm256_sub_ps(move_y, pad_move_y);
+    __m256 entry_x, exit_x, entry_y, exit_y;
+    __m256 hit = _mm256_and_ps(slab_times_avx2(position_x, move_x, extent_x, entry_x, exit_x),
+                               slab_times_avx2(position_y, relative_y, extent_y, entry_y, exit_y));
+    __m256 entry = _mm256_max_ps(entry_x, entry_y);
+    __m256 exit = _mm256_min_ps(exit_x, exit_y);
+    hit = _mm256_and_ps(hit, _mm256_and_ps(_mm256_cmp_ps(entry, exit, _CMP_LT_OQ),
+                                           _mm256_and_ps(_mm256_cmp_ps(exit, zero, _CMP_GT_OQ),
+                                                         _mm256_cmp_ps(entry, one, _CMP_LE_OQ))));
+
+    __m256 inside = _mm256_cmp_ps(entry, zero, _CMP_LT_OQ);
+    __m256 x_face = _mm256_cmp_ps(entry_x, entry_y, _CMP_GT_OQ);
+    __m256 normal_x = _mm256_and_ps(x_face, _mm256_blendv_ps(one, minus_one, _mm256_cmp_ps(move_x, zero, _CMP_GT_OQ)));
+    __m256 normal_y = _mm256_andnot_ps(x_face, _mm256_blendv_ps(one, minus_one, _mm256_cmp_ps(relative_y, zero, _CMP_GT_OQ)));
+    __m256 along_x = _mm256_cmp_ps(_mm256_sub_ps(extent_x, _mm256_and_ps(position_x, abs_mask)),
+                                   _mm256_sub_ps(extent_y, _mm256_and_ps(position_y, abs_mask)), _CMP_LT_OQ);
+    __m256 closing = _mm256_blendv_ps(_mm256_mul_ps(position_y, relative_y), _mm256_mul_ps(position_x, move_x), along_x);
+    hit = _mm256_andnot_ps(_mm256_and_ps(inside, _mm256_cmp_ps(closing, zero, _CMP_GE_OQ)), hit);
+    __m256 time = _mm256_andnot_ps(inside, entry);
+    __m256 side_x = _mm256_blendv_ps(one, minus_one, _mm256_cmp_ps(ball_x, pad_x, _CMP_LT_OQ));
+    normal_x = _mm256_blendv_ps(normal_x, side_x, inside);
+    normal_y = _mm256_andnot_ps(inside, normal_y);
+
+    __m256 heading_away = _mm256_cmp_ps(_mm256_add_ps(_mm256_mul_ps(normal_x, movement_x),
+                                                      _mm256_mul_ps(normal_y, movement_y)), zero, _CMP_GT_OQ);
+    __m256 pushed = _mm256_and_ps(heading_away, _mm256_cmp_ps(normal_y, zero, _CMP_NEQ_OQ));
+    __m256 contact_x = _mm256_add_ps(ball_x, _mm256_mul_ps(move_x, time));
+    __m256 pushed_x = _mm256_blendv_ps(one, minus_one, _mm256_cmp_ps(contact_x, pad_x, _CMP_LT_OQ));
+    normal_x = _mm256_blendv_ps(normal_x, pushed_x, pushed);
+    normal_y = _mm256_andnot_ps(pushed, normal_y);
+    heading_away = _mm256_blendv_ps(heading_away, _mm256_cmp_ps(_mm256_mul_ps(pushed_x, movement_x), zero, _CMP_GT_OQ), pushed);
+
+    __m256 earlier = _mm256_and_ps(_mm256_andnot_ps(heading_away, hit), _mm256_cmp_ps(time, first.time, _CMP_LT_OQ));
+    first.time = _mm256_blendv_ps(first.time, time, earlier);
+    first.goal = _mm256_andnot_ps(earlier, first.goal);
+    first.wall = _mm256_andnot_ps(earlier, first.wall);
+    first.paddle = _mm256_or_ps(first.paddle, earlier);
+    first.normal_x = _mm256_blendv_ps(first.normal_x, normal_x, earlier);
+    first.normal_y = _mm256_blendv_ps(first.normal_y, normal_y, earlier);
+}
+
+// Eight matches per iteration, same steps as step_sse2
+AVX2_FUNCTION static void step_avx2(MatchBatch &b, const float *left_input, const float *right_input,
+                                    float delta_time, const StepConstants &c)
+{
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 dt = _mm256_set1_ps(delta_time);
+    const __m256 pad_scale = _mm256_set1_ps(c.pad_step_scale);
+    const __m256 ball_scale = _mm256_set1_ps(c.ball_step_scale);
+    const __m256 rot_step = _mm256_set1_ps(c.rot_step);
+    const __m256 full_turn = _mm256_set1_ps(FULL_TURN);
+    const __m256 pad_bound = _mm256_set1_ps(c.pad_bound);
+    const __m256 goal_bound = _mm256_set1_ps(c.goal_bound);
+    const __m256 wall_bound = _mm256_set1_ps(c.wall_bound);
+    const __m256 extent_x = _mm256_set1_ps(c.extent_x);
+    const __m256 extent_y = _mm256_set1_ps(c.extent_y);
+    const __m256 left_x = _mm256_set1_ps(c.left_pad_x), left_init_y = _mm256_set1_ps(c.left_pad_y);
+    const __m256 right_x = _mm256_set1_ps(c.right_pad_x), right_init_y = _mm256_set1_ps(c.right_pad_y);
+    const __m256 ball_init_x = _mm256_set1_ps(c.ball_x), ball_init_y = _mm256_set1_ps(c.ball_y);
+    const __m256i one_i = _mm256_set1_epi32(1), two_i = _mm256_set1_epi32(2);
+
+    for (size_t i = 0; i < b.padded_count; i += 8)
+    {
+        __m256i ended = _mm256_load_si256((const __m256i*) (b.end_game + i));
+        __m256 active = _mm256_castsi256_ps(_mm256_cmpeq_epi32(ended, _mm256_setzero_si256()));
+        if (_mm256_movemask_ps(active) == 0) { continue; }
+
+        // Paddles
+        __m256 left_start = _mm256_add_ps(left_init_y, _mm256_load_ps(b.position_left_pad_y + i));
+        __m256 right_start = _mm256_add_ps(right_init_y, _mm256_load_ps(b.position_right_pad_y + i));
+        __m256 left_y = slide_paddle_avx2(b.position_left_pad_y + i, left_input + i, active,
+                                          pad_scale, dt, left_init_y, pad_bound);
+        __m256 right_y = slide_paddle_avx2(b.position_right_pad_y + i, right_input + i, active,
+                                           pad_scale, dt, right_init_y, pad_bound);
+        __m256 left_step = _mm256_sub_ps(_mm256_add_ps(left_init_y, left_y), left_start);
+        __m256 right_step = _mm256_sub_ps(_mm256_add_ps(right_init_y, right_y), right_start);
+
+        // Ball
+        __m256 old_x = _mm256_load_ps(b.position_ball_x + i);
+        __m256 old_y = _mm256_load_ps(b.position_ball_y + i);
+        __m256 ball_x = _mm256_add_ps(ball_init_x, old_x);
+        __m256 ball_y = _mm256_add_ps(ball_init_y, old_y);
+        __m256 movement_x = _mm256_load_ps(b.movement_ball_x + i);
+        __m256 movement_y = _mm256_load_ps(b.movement_ball_y + i);
+        __m256i winner = _mm256_load_si256((const __m256i*) (b.winner + i));
+        __m256i hits = _mm256_load_si256((const __m256i*) (b.paddle_hits + i));
+        __m256 elapsed = zero;
+        __m256 stepping = active;
+        for (int event = 0; event < MAX_EVENTS_PER_STEP; event++)
+        {
+            stepping = _mm256_and_ps(stepping, _mm256_cmp_ps(elapsed, one, _CMP_LT_OQ));
+            if (_mm256_movemask_ps(stepping) == 0) { break; }
+
+            __m256 remaining = _mm256_sub_ps(one, elapsed);
+            __m256 scale = _mm256_mul_ps(dt, remaining);
+            __m256 move_x = _mm256_mul_ps(_mm256_mul_ps(movement_x, ball_scale), scale);
+            __m256 move_y = _mm256_mul_ps(_mm256_mul_ps(movement_y, ball_scale), scale);
+
+            ContactAvx2 first;
+            __m256 valid;
+            __m256 time = wall_time_avx2(ball_x, move_x, goal_bound, valid);
+            first.goal = _mm256_and_ps(valid, _mm256_cmp_ps(time, one, _CMP_LE_OQ));
+            first.time = _mm256_blendv_ps(one, time, first.goal);
+            time = wall_time_avx2(ball_y, move_y, wall_bound, valid);
+            first.wall = _mm256_and_ps(valid, _mm256_cmp_ps(time, first.time, _CMP_LT_OQ));
+            first.time = _mm256_blendv_ps(first.time, time, first.wall);
+            first.goal = _mm256_andnot_ps(first.wall, first.goal);
+            first.paddle = zero;
+            first.normal_x = zero;
+            first.normal_y = zero;
+            paddle_contact_avx2(ball_x, ball_y, move_x, move_y, movement_x, movement_y,
+                                left_x, _mm256_add_ps(left_start, _mm256_mul_ps(left_step, elapsed)),
+                                _mm256_mul_ps(left_step, remaining), extent_x, extent_y, first);
+            paddle_contact_avx2(ball_x, ball_y, move_x, move_y, movement_x, movement_y,
+                                right_x, _mm256_add_ps(right_start, _mm256_mul_ps(right_step, elapsed)),
+                                _mm256_mul_ps(right_step, remaining), extent_x, extent_y, first);
+
+            // Move up to the contact
+            ball_x = _mm256_blendv_ps(ball_x, _mm256_add_ps(ball_x, _mm256_mul_ps(move_x, first.time)), stepping);
+            ball_y = _mm256_blendv_ps(ball_y, _mm256_add_ps(ball_y, _mm256_mul_ps(move_y, first.time)), stepping);
+            elapsed = _mm256_blendv_ps(elapsed, _mm256_add_ps(elapsed, _mm256_mul_ps(remaining, first.time)), stepping);
+
+            __m256 scored = _mm256_and_ps(stepping, first.goal);
+            __m256 bounced = _mm256_and_ps(stepping, first.wall);
+            __m256 reflected = _mm256_and_ps(stepping, first.paddle);
+            __m256 side_face = _mm256_cmp_ps(first.normal_x, zero, _CMP_NEQ_OQ);
+
+            __m256i left_won = _mm256_castps_si256(_mm256_cmp_ps(ball_x, zero, _CMP_LT_OQ));
+            __m256i side = _mm256_blendv_epi8(one_i, two_i, left_won);
+            winner = _mm256_blendv_epi8(winner, side, _mm256_castps_si256(scored));
+            ended = _mm256_or_si256(ended, _mm256_castps_si256(scored));
+            movement_y = _mm256_xor_ps(movement_y, _mm256_and_ps(bounced, sign));
+            movement_x = _mm256_blendv_ps(movement_x, _mm256_mul_ps(_mm256_and_ps(movement_x, abs_mask), first.normal_x),
+                                          _mm256_and_ps(reflected, side_face));
+            movement_y = _mm256_blendv_ps(movement_y, _mm256_mul_ps(_mm256_and_ps(movement_y, abs_mask), first.normal_y),
+                                          _mm256_andnot_ps(side_face, reflected));
+            hits = _mm256_sub_epi32(hits, _mm256_castps_si256(reflected));
+
+            stepping = _mm256_and_ps(stepping, _mm256_or_ps(bounced, reflected));
+        }
+
+        _mm256_store_ps(b.position_ball_x + i, _mm256_blendv_ps(old_x, _mm256_sub_ps(ball_x, ball_init_x), active));
+        _mm256_store_ps(b.position_ball_y + i, _mm256_blendv_ps(old_y, _mm256_sub_ps(ball_y, ball_init_y), active));
+        _mm256_store_ps(b.movement_ball_x + i, movement_x);
+        _mm256_store_ps(b.movement_ball_y + i, movement_y);
+        __m256 rot = _mm256_load_ps(b.rot_angle + i);
+        __m256 turned = _mm256_add_ps(rot, rot_step);
+        turned = _mm256_sub_ps(turned, _mm256_and_ps(_mm256_cmp_ps(turned, full_turn, _CMP_GE_OQ), full_turn));
+        _mm256_store_ps(b.rot_angle + i, _mm256_blendv_ps(rot, turned, active));
+
+        _mm256_store_si256((__m256i*) (b.winner + i), winner);
+        _mm256_store_si256((__m256i*) (b.end_game + i), ended);
+        _mm256_store_si256((__m256i*) (b.paddle_hits + i), hits);
+    }
+}
+
+#endif
+
+size_t MatchBatch::Step(const float *left_input, const float *right_input, float delta_time)
+{
+    StepConstants c = make_constants(delta_time);
+
+    if (simd_level == SIMD_AVX2)
+    {
+#ifdef POKEPONG_X86_DISPATCH
+        step_avx2(*this, left_input, right_input, delta_time, c);
+#endif
+    }
+    else if (simd_level == SIMD_SSE2)
+    {
+#ifdef __SSE2__
+        step_sse2(*this, left_input, right_input, delta_time, c);
+#endif
+    }
+    else { step_scalar(*this, left_input, right_input, delta_time, c); }
+
+    size_t running = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (end_game[i] == 0) { running++; }
+    }
+    return running;
+}
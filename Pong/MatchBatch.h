@@ -0,0 +1,55 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "Simulation.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// Lanes per AVX2 register, arrays are padded to a multiple of this
+const size_t MATCH_BATCH_LANES = 8;
+
+// Structure-of-arrays store for many matches stepped in lockstep.
+// Same rules as step() in Simulation.cpp, swept contacts included, but only
+// the y of the paddles and the x/y of the ball are kept, each in its own
+// 32-byte aligned array.
+class MatchBatch {
+    public:
+        explicit MatchBatch(size_t count);
+        ~MatchBatch();
+
+        // Puts match i back at kick-off
+        void Reset(size_t i, const glm::vec3 &movement_ball = INIT_MOVEMENT_BALL);
+
+        // Copy one match in or out of the batch
+        void Load(size_t i, const MatchState &state);
+        void Store(size_t i, MatchState &state) const;
+
+        // Advances every running match by delta_time. Inputs hold one paddle
+        // direction per match and must be padded_count long.
+        // Returns how many matches are still running.
+        size_t Step(const float *left_input, const float *right_input, float delta_time);
+
+        size_t count;
+        size_t padded_count;
+        SimdLevel simd_level;
+
+        // Offsets from INIT_POSITION_*, like MatchState
+        float *position_left_pad_y;
+        float *position_right_pad_y;
+        float *position_ball_x;
+        float *position_ball_y;
+        float *movement_ball_x;
+        float *movement_ball_y;
+        float *rot_angle;
+
+        // 0 while running, -1 (all bits set) once the match ended
+        int32_t *end_game;
+        int32_t *winner;
+        int32_t *paddle_hits;
+
+    private:
+        MatchBatch(const MatchBatch&);
+        MatchBatch& operator=(const MatchBatch&);
+
+        void *storage;
+};
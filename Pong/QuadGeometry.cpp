@@ -0,0 +1,66 @@
+#include "QuadGeometry.h"
+#include "GLStateCache.h"
+#include <stdio.h>
+#include <vector>
+
+bool gl_version_at_least(int major, int minor)
+{
+    // "major.minor[.release] vendor", GL_MAJOR_VERSION only exists from 3.0
+    const char *version = (const char*) glGetString(GL_VERSION);
+    int context_major = 0, context_minor = 0;
+    if (version == NULL or sscanf(version, "%d.%d", &context_major, &context_minor) != 2) { return false; }
+    return context_major > major or (context_major == major and context_minor >= minor);
+}
+
+bool gl_has_vertex_arrays()
+{
+    return gl_version_at_least(3, 0);
+}
+
+bool gl_has_instancing()
+{
+    return gl_version_at_least(3, 3);
+}
+
+QuadGeometry::QuadGeometry() : capacity(0), index_buffer(0), vertex_array(0) {}
+
+void QuadGeometry::Initialise(size_t quad_capacity)
+{
+    capacity = quad_capacity < QUAD_MAX_CAPACITY ? quad_capacity : QUAD_MAX_CAPACITY;
+    std::vector<GLushort> indices(capacity * QUAD_INDICES);
+    for (size_t quad = 0; quad < capacity; quad++)
+    {
+        for (int i = 0; i < QUAD_INDICES; i++)
+        {
+            indices[quad * QUAD_INDICES + i] = (GLushort) (quad * QUAD_CORNERS + QUAD_TRIANGLES[i]);
+        }
+    }
+
+    // The element binding belongs to the vertex array, so create that first
+    if (gl_has_vertex_arrays())
+    {
+        glGenVertexArrays(1, &vertex_array);
+        gl_state().BindVertexArray(vertex_array);
+    }
+    glGenBuffers(1, &index_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW);
+}
+
+void QuadGeometry::Cleanup()
+{
+    glDeleteBuffers(1, &index_buffer);
+    index_buffer = 0;
+    if (vertex_array != 0)
+    {
+        gl_state().ForgetVertexArray(vertex_array);
+        glDeleteVertexArrays(1, &vertex_array);
+        vertex_array = 0;
+    }
+}
+
+void QuadGeometry::Bind()
+{
+    if (vertex_array != 0) { gl_state().BindVertexArray(vertex_array); }
+    else { glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer); }
+}
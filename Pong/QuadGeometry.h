@@ -0,0 +1,48 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stddef.h>
+
+// Quads are four corners, drawn as two triangles through an index buffer
+const int QUAD_CORNERS = 4;
+const int QUAD_INDICES = 6;
+
+// Corners of the unit quad around the origin, counter-clockwise from the
+// bottom left, and the two triangles over them
+const float UNIT_QUAD_CORNERS[QUAD_CORNERS][2] = {
+    { -0.5f, -0.5f }, { 0.5f, -0.5f }, { 0.5f, 0.5f }, { -0.5f, 0.5f }
+};
+const GLushort QUAD_TRIANGLES[QUAD_INDICES] = { 0, 1, 2, 0, 2, 3 };
+// Most quads 16-bit indices can reach
+const size_t QUAD_MAX_CAPACITY = 65536 / QUAD_CORNERS;
+
+// Whether the current context is at least the given version
+bool gl_version_at_least(int major, int minor);
+// Vertex array objects exist from GL 3.0; core profiles require one bound
+bool gl_has_vertex_arrays();
+// Instanced draws with per-instance attributes are core from GL 3.3
+bool gl_has_instancing();
+
+// Static index buffer for up to capacity quads laid out four corners
+// apiece, plus the vertex array that ties it to a vertex buffer. Uploaded
+// once, so indexing costs no per-frame traffic.
+class QuadGeometry {
+    public:
+        QuadGeometry();
+
+        void Initialise(size_t capacity);
+        void Cleanup();
+
+        // Capacity is clamped to QUAD_MAX_CAPACITY
+        // Binds the vertex array, or the index buffer where there is none
+        void Bind();
+
+        size_t capacity;
+        GLuint index_buffer;
+        // 0 on contexts without vertex arrays
+        GLuint vertex_array;
+};
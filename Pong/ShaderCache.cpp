@@ -0,0 +1,220 @@
+#include "ShaderCache.h"
+#include "GameClock.h"
+#include "Logger.h"
+#include "Tracer.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// Starts every file in the binary directory, the driver's blob follows
+struct ProgramBinaryHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t format;
+    uint64_t sources;
+    uint64_t driver;
+    uint64_t length;
+};
+
+static_assert(sizeof(ProgramBinaryHeader) == 40, "ProgramBinaryHeader layout");
+
+const char PROGRAM_BINARY_MAGIC[8] = { 'P', 'K', 'P', 'R', 'O', 'G', '\0', '\0' };
+const uint32_t PROGRAM_BINARY_VERSION = 1;
+// Anything bigger is a damaged file, real programs are tens of kilobytes
+const uint64_t PROGRAM_BINARY_MAX_BYTES = 16 << 20;
+
+// FNV-1a over one string, continuing from hash
+static uint64_t fnv1a(uint64_t hash, const std::string &text)
+{
+    for (unsigned char c : text)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+uint64_t hash_shader_sources(const std::string &vertex_source, const std::string &fragment_source)
+{
+    // The length keeps "ab"+"c" and "a"+"bc" apart
+    uint64_t hash = fnv1a(14695981039346656037ULL, vertex_source);
+    hash = fnv1a(hash, std::to_string(vertex_source.size()));
+    return fnv1a(hash, fragment_source);
+}
+
+static std::string gl_string(GLenum name)
+{
+    const char *value = (const char*) glGetString(name);
+    return value != NULL ? value : "";
+}
+
+ShaderCache::ShaderCache()
+    : compiles(0), hits(0), binary_hits(0), binary_misses(0), binary_rejects(0),
+      compile_seconds(0.0), restore_seconds(0.0), driver(0)
+{
+}
+
+bool ShaderCache::SetBinaryDirectory(const std::string &directory)
+{
+    binary_directory.clear();
+    if (!ShaderProgram::BinariesSupported()) { return false; }
+    // A new driver or GPU may still take an old binary, but isn't trusted to
+    driver = hash_shader_sources(gl_string(GL_VENDOR) + "\n" + gl_string(GL_RENDERER), gl_string(GL_VERSION));
+    binary_directory = directory;
+    if (!binary_directory.empty() and binary_directory.back() != '/') { binary_directory += '/'; }
+    ShaderProgram::retrievableBinaries = true;
+    return true;
+}
+
+std::shared_ptr<ShaderProgram> ShaderCache::Load(const char *vertex_path, const char *fragment_path)
+{
+    TRACE_ZONE_DETAIL("ShaderCache::Load", vertex_path);
+    return LoadFromStrings(ShaderProgram::ReadShaderFile(vertex_path), ShaderProgram::ReadShaderFile(fragment_path));
+}
+
+std::shared_ptr<ShaderProgram> ShaderCache::LoadFromStrings(const std::string &vertex_source,
+                                                            const std::string &fragment_source)
+{
+    uint64_t key = hash_shader_sources(vertex_source, fragment_source);
+    auto range = entries.equal_range(key);
+    for (auto it = range.first; it != range.second;)
+    {
+        std::shared_ptr<ShaderProgram> program = it->second.program.lock();
+        if (!program)
+        {
+            it = entries.erase(it);
+            continue;
+        }
+        if (it->second.vertex_source == vertex_source and it->second.fragment_source == fragment_source)
+        {
+            hits++;
+            return program;
+        }
+        ++it;
+    }
+
+    ShaderProgram *created = new ShaderProgram();
+    // The same text compiles to something else under the core preamble
+    uint64_t sources = hash_shader_sources(vertex_source + (ShaderProgram::coreProfile ? "core" : "legacy"),
+                                           fragment_source);
+    uint64_t start = clock_counter();
+    bool restored = !binary_directory.empty() and ReadBinary(sources, *created);
+    if (!restored)
+    {
+        created->LoadFromStrings(vertex_source, fragment_source);
+        compiles++;
+    }
+    double seconds = (double) (clock_counter() - start) / clock_frequency();
+    if (restored)
+    {
+        restore_seconds += seconds;
+        LOG_INFO("Shader program " << BinaryPath(sources) << " restored in " << seconds * 1000.0 << " ms");
+    }
+    else
+    {
+        compile_seconds += seconds;
+        LOG_INFO("Shader program compiled and linked in " << seconds * 1000.0 << " ms");
+        if (!binary_directory.empty()) { WriteBinary(sources, *created); }
+    }
+    std::shared_ptr<ShaderProgram> program(created, [](ShaderProgram *released)
+    {
+        released->Cleanup();
+        delete released;
+    });
+    Entry entry = { vertex_source, fragment_source, program };
+    entries.insert(std::make_pair(key, entry));
+    return program;
+}
+
+size_t ShaderCache::Size()
+{
+    size_t alive = 0;
+    for (auto it = entries.begin(); it != entries.end();)
+    {
+        if (it->second.program.expired()) { it = entries.erase(it); }
+        else
+        {
+            alive++;
+            ++it;
+        }
+    }
+    return alive;
+}
+
+std::string ShaderCache::BinaryPath(uint64_t sources) const
+{
+    char name[32];
+    snprintf(name, sizeof(name), "program_%016" PRIx64 ".bin", sources);
+    return binary_directory + name;
+}
+
+bool ShaderCache::ReadBinary(uint64_t sources, ShaderProgram &program)
+{
+    TRACE_ZONE("ShaderCache::ReadBinary");
+    std::string path = BinaryPath(sources);
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == NULL)
+    {
+        binary_misses++;
+        return false;
+    }
+    ProgramBinaryHeader header;
+    std::vector<unsigned char> binary;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+              and memcmp(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic)) == 0
+              and header.version == PROGRAM_BINARY_VERSION
+              and header.sources == sources and header.driver == driver
+              and header.length > 0 and header.length <= PROGRAM_BINARY_MAX_BYTES;
+    if (ok)
+    {
+        binary.resize((size_t) header.length);
+        ok = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (ok and program.LoadFromBinary((GLenum) header.format, binary))
+    {
+        binary_hits++;
+        return true;
+    }
+    // Compiled instead, and the file written over
+    LOG_INFO("Shader program " << path << " is from another driver or damaged, compiling");
+    binary_rejects++;
+    return false;
+}
+
+void ShaderCache::WriteBinary(uint64_t sources, ShaderProgram &program)
+{
+    TRACE_ZONE("ShaderCache::WriteBinary");
+    GLenum format = 0;
+    std::vector<unsigned char> binary;
+    if (!program.GetBinary(format, binary)) { return; }
+    ProgramBinaryHeader header;
+    memcpy(header.magic, PROGRAM_BINARY_MAGIC, sizeof(header.magic));
+    header.version = PROGRAM_BINARY_VERSION;
+    header.format = format;
+    header.sources = sources;
+    header.driver = driver;
+    header.length = binary.size();
+
+    // Written aside and renamed, so a crash never leaves half a program
+    std::string path = BinaryPath(sources);
+    std::string temporary = path + ".tmp";
+    FILE *file = fopen(temporary.c_str(), "wb");
+    if (file == NULL)
+    {
+        LOG_WARN("Unable to save shader program to " << temporary);
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+              and fwrite(binary.data(), 1, binary.size(), file) == binary.size();
+    ok = fclose(file) == 0 and ok;
+    // Windows won't rename over an existing file
+    remove(path.c_str());
+    if (!ok or rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        LOG_WARN("Unable to save shader program to " << path);
+        remove(temporary.c_str());
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ShaderProgram.h"
+#include <map>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Hands out one linked program per distinct vertex/fragment source pair.
+// Programs are shared; the last holder to let go calls Cleanup() on it.
+class ShaderCache {
+    public:
+        ShaderCache();
+
+        // Saves each program linked from now on under directory and, on
+        // later launches, restores it instead of compiling. Files are keyed
+        // by the sources, the profile and the driver's vendor, renderer and
+        // version, and any the driver rejects are compiled and replaced.
+        // False when the context can't hand out binaries.
+        bool SetBinaryDirectory(const std::string &directory);
+
+        // Reads both files and returns the program built from their contents
+        std::shared_ptr<ShaderProgram> Load(const char *vertex_path, const char *fragment_path);
+        std::shared_ptr<ShaderProgram> LoadFromStrings(const std::string &vertex_source,
+                                                       const std::string &fragment_source);
+
+        // Programs still alive
+        size_t Size();
+
+        size_t compiles;
+        size_t hits;
+        // Programs restored from the binary directory, looked for and not
+        // found, and found but turned down by the driver
+        size_t binary_hits;
+        size_t binary_misses;
+        size_t binary_rejects;
+        double compile_seconds;
+        double restore_seconds;
+
+    private:
+        std::string BinaryPath(uint64_t sources) const;
+        bool ReadBinary(uint64_t sources, ShaderProgram &program);
+        void WriteBinary(uint64_t sources, ShaderProgram &program);
+
+        struct Entry
+        {
+            std::string vertex_source;
+            std::string fragment_source;
+            std::weak_ptr<ShaderProgram> program;
+        };
+
+        // Entries are keyed by a hash of both sources; equal hashes still
+        // compare the text so a collision can't hand out the wrong program
+        std::multimap<uint64_t, Entry> entries;
+        // Empty while binaries are off
+        std::string binary_directory;
+        uint64_t driver;
+};
+
+uint64_t hash_shader_sources(const std::string &vertex_source, const std::string &fragment_source);
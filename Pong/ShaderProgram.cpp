@@ -1,18 +1,72 @@
 #define GL_SILENCE_DEPRECATION
 
 #include "ShaderProgram.h"
+#include "AssetSource.h"
+#include "GLStateCache.h"
+#include "QuadGeometry.h"
+#include "Tracer.h"
+#include <SDL.h>
+
+// Bits of uploadedUniforms
+enum {
+    UNIFORM_MODEL_MATRIX      = 1 << 0,
+    UNIFORM_PROJECTION_MATRIX = 1 << 1,
+    UNIFORM_VIEW_MATRIX       = 1 << 2,
+    UNIFORM_COLOR             = 1 << 3
+};
+
+bool ShaderProgram::coreProfile = false;
+bool ShaderProgram::retrievableBinaries = false;
+
+// Loaded at runtime, the 2.1 context and older drivers don't export them
+static PFNGLGETPROGRAMBINARYPROC get_program_binary = NULL;
+static PFNGLPROGRAMBINARYPROC program_binary = NULL;
+static PFNGLPROGRAMPARAMETERIPROC program_parameter = NULL;
+
+// Lets the GLSL 1.10 shaders compile as GLSL 330 core
+const char CORE_VERTEX_PREAMBLE[] =
+    "#version 330 core\n"
+    "#define attribute in\n"
+    "#define varying out\n";
+const char CORE_FRAGMENT_PREAMBLE[] =
+    "#version 330 core\n"
+    "#define varying in\n"
+    "#define texture2D texture\n"
+    "out vec4 fragColor;\n";
+
+// Core GLSL has no gl_FragColor, and gl_ names can't be macros
+static std::string to_core_glsl(const std::string &shaderContents, GLenum type) {
+    if (type != GL_FRAGMENT_SHADER) {
+        return CORE_VERTEX_PREAMBLE + shaderContents;
+    }
+    std::string contents = shaderContents;
+    const std::string legacyOutput = "gl_FragColor";
+    for (size_t at = contents.find(legacyOutput); at != std::string::npos; at = contents.find(legacyOutput, at)) {
+        contents.replace(at, legacyOutput.size(), "fragColor");
+    }
+    return CORE_FRAGMENT_PREAMBLE + contents;
+}
 
 void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShaderFile) {
+    TRACE_ZONE_DETAIL("ShaderProgram::Load", vertexShaderFile);
+    LoadFromStrings(ReadShaderFile(vertexShaderFile), ReadShaderFile(fragmentShaderFile));
+}
+
+void ShaderProgram::LoadFromStrings(const std::string &vertexShaderContents, const std::string &fragmentShaderContents) {
+    TRACE_ZONE("ShaderProgram::LoadFromStrings");
     
     // create the vertex shader
-    vertexShader = LoadShaderFromFile(vertexShaderFile, GL_VERTEX_SHADER);
+    vertexShader = LoadShaderFromString(vertexShaderContents, GL_VERTEX_SHADER);
     // create the fragment shader
-    fragmentShader = LoadShaderFromFile(fragmentShaderFile, GL_FRAGMENT_SHADER);
+    fragmentShader = LoadShaderFromString(fragmentShaderContents, GL_FRAGMENT_SHADER);
     
     // Create the final shader program from our vertex and fragment shaders
     programID = glCreateProgram();
     glAttachShader(programID, vertexShader);
     glAttachShader(programID, fragmentShader);
+    if(retrievableBinaries and BinariesSupported()) {
+        program_parameter(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(programID);
     
     GLint linkSuccess;
@@ -21,38 +75,111 @@ void ShaderProgram::Load(const char *vertexShaderFile, const char *fragmentShade
 	printf("Error linking shader program!\n");
     }
     
+    FindLocations();
+}
+
+bool ShaderProgram::LoadFromBinary(GLenum format, const std::vector<unsigned char> &binary) {
+    TRACE_ZONE("ShaderProgram::LoadFromBinary");
+    if(!BinariesSupported()) {
+        return false;
+    }
+    
+    // Linked already, there are no shader objects to keep
+    vertexShader = 0;
+    fragmentShader = 0;
+    programID = glCreateProgram();
+    program_binary(programID, format, binary.data(), (GLsizei) binary.size());
+    
+    // A driver update or a different GPU fails the link rather than erroring
+    GLint linkSuccess;
+    glGetProgramiv(programID, GL_LINK_STATUS, &linkSuccess);
+    if(linkSuccess == GL_FALSE) {
+        while(glGetError() != GL_NO_ERROR) {}
+        glDeleteProgram(programID);
+        programID = 0;
+        return false;
+    }
+    
+    FindLocations();
+    return true;
+}
+
+bool ShaderProgram::GetBinary(GLenum &format, std::vector<unsigned char> &binary) {
+    if(!BinariesSupported()) {
+        return false;
+    }
+    GLint linkSuccess = GL_FALSE, length = 0;
+    glGetProgramiv(programID, GL_LINK_STATUS, &linkSuccess);
+    glGetProgramiv(programID, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(linkSuccess == GL_FALSE or length <= 0) {
+        return false;
+    }
+    binary.resize(length);
+    GLsizei written = 0;
+    get_program_binary(programID, length, &written, &format, binary.data());
+    binary.resize(written);
+    return written > 0;
+}
+
+bool ShaderProgram::BinariesSupported() {
+    if(get_program_binary != NULL) {
+        return true;
+    }
+    if(!gl_version_at_least(4, 1) and !SDL_GL_ExtensionSupported("GL_ARB_get_program_binary")) {
+        return false;
+    }
+    // macOS reports the extension with no formats to save in
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if(formats <= 0) {
+        return false;
+    }
+    program_binary = (PFNGLPROGRAMBINARYPROC) SDL_GL_GetProcAddress("glProgramBinary");
+    program_parameter = (PFNGLPROGRAMPARAMETERIPROC) SDL_GL_GetProcAddress("glProgramParameteri");
+    if(program_binary == NULL or program_parameter == NULL) {
+        return false;
+    }
+    get_program_binary = (PFNGLGETPROGRAMBINARYPROC) SDL_GL_GetProcAddress("glGetProgramBinary");
+    return get_program_binary != NULL;
+}
+
+void ShaderProgram::FindLocations() {
     modelMatrixUniform = glGetUniformLocation(programID, "modelMatrix");
     projectionMatrixUniform = glGetUniformLocation(programID, "projectionMatrix");
     viewMatrixUniform = glGetUniformLocation(programID, "viewMatrix");
 	colorUniform = glGetUniformLocation(programID, "color");
+    uploadedUniforms = 0;
     
     positionAttribute = glGetAttribLocation(programID, "position");
     texCoordAttribute = glGetAttribLocation(programID, "texCoord");
+    instanceTransformAttribute = glGetAttribLocation(programID, "instanceTransform");
+    instanceRotationAttribute = glGetAttribLocation(programID, "instanceRotation");
+    instanceUvAttribute = glGetAttribLocation(programID, "instanceUv");
+    instanceTintAttribute = glGetAttribLocation(programID, "instanceTint");
 	
 	SetColor(1.0f, 1.0f, 1.0f, 1.0f);
     
 }
 
 void ShaderProgram::Cleanup() {
+    gl_state().ForgetProgram(programID);
     glDeleteProgram(programID);
     glDeleteShader(vertexShader);
     glDeleteShader(fragmentShader);
 }
 
 GLuint ShaderProgram::LoadShaderFromFile(const std::string &shaderFile, GLenum type) {
-    //Open a file stream with the file name
-    std::ifstream infile(shaderFile);
-    
-    if(infile.fail()) {
+    // Load the shader from the contents of the file
+    return LoadShaderFromString(ReadShaderFile(shaderFile), type);
+}
+
+std::string ShaderProgram::ReadShaderFile(const std::string &shaderFile) {
+    //Built into the executable or read off disk, see AssetSource.h
+    std::string contents;
+    if(!read_asset(shaderFile.c_str(), contents)) {
         std::cout << "Error opening shader file:" << shaderFile << std::endl;
     }
-    
-    //Create a string buffer and stream the file to it
-    std::stringstream buffer;
-    buffer << infile.rdbuf();
-    
-    // Load the shader from the contents of the file
-    return LoadShaderFromString(buffer.str(), type);
+    return contents;
 }
 
 GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GLenum type) {
@@ -62,8 +189,9 @@ GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GL
     GLuint shaderID = glCreateShader(type);
     
     // Get the pointer to the C string from the STL string
-    const char *shaderString = shaderContents.c_str();
-    GLint shaderStringLength = (GLint) shaderContents.size();
+    const std::string source = coreProfile ? to_core_glsl(shaderContents, type) : shaderContents;
+    const char *shaderString = source.c_str();
+    GLint shaderStringLength = (GLint) source.size();
     
     // Set the shader source to the string and compile shader
     glShaderSource(shaderID, 1, &shaderString, &shaderStringLength);
@@ -84,22 +212,38 @@ GLuint ShaderProgram::LoadShaderFromString(const std::string &shaderContents, GL
     return shaderID;
 }
 
+bool ShaderProgram::NeedsUpload(unsigned uniform, bool unchanged) {
+    bool saved = (uploadedUniforms & uniform) and unchanged;
+    gl_state().CountUniform(saved);
+    if (saved) {
+        return false;
+    }
+    uploadedUniforms |= uniform;
+    gl_state().UseProgram(programID);
+    return true;
+}
+
 void ShaderProgram::SetColor(float r, float g, float b, float a) {
-	glUseProgram(programID);
+	glm::vec4 newColor(r, g, b, a);
+	if (!NeedsUpload(UNIFORM_COLOR, color == newColor)) { return; }
+	color = newColor;
 	glUniform4f(colorUniform, r, g, b, a);
 }
 
 void ShaderProgram::SetViewMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
+    if (!NeedsUpload(UNIFORM_VIEW_MATRIX, viewMatrix == matrix)) { return; }
+    viewMatrix = matrix;
     glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
 }
 
 void ShaderProgram::SetModelMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
+    if (!NeedsUpload(UNIFORM_MODEL_MATRIX, modelMatrix == matrix)) { return; }
+    modelMatrix = matrix;
     glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
 }
 
 void ShaderProgram::SetProjectionMatrix(const glm::mat4 &matrix) {
-    glUseProgram(programID);
-    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &matrix[0][0]);    
+    if (!NeedsUpload(UNIFORM_PROJECTION_MATRIX, projectionMatrix == matrix)) { return; }
+    projectionMatrix = matrix;
+    glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, &matrix[0][0]);
 }
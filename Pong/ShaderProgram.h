@@ -9,12 +9,19 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include "glm/mat4x4.hpp"
+#include "glm/vec4.hpp"
 
 class ShaderProgram {
     public:
 	
 		void Load(const char *vertexShaderFile, const char *fragmentShaderFile);
+		void LoadFromStrings(const std::string &vertexShaderContents, const std::string &fragmentShaderContents);
+		// Restores a program GetBinary() saved, false if the driver rejects it
+		bool LoadFromBinary(GLenum format, const std::vector<unsigned char> &binary);
+		// The linked program in the driver's own format, false if not linked
+		bool GetBinary(GLenum &format, std::vector<unsigned char> &binary);
 		void Cleanup();
 
 		void SetModelMatrix(const glm::mat4 &matrix);
@@ -25,6 +32,16 @@ class ShaderProgram {
 	
         GLuint LoadShaderFromString(const std::string &shaderContents, GLenum type);
         GLuint LoadShaderFromFile(const std::string &shaderFile, GLenum type);
+        static std::string ReadShaderFile(const std::string &shaderFile);
+    
+        // Set once the context exists. Core profiles get GLSL 330 with the
+        // legacy keywords the shaders use mapped onto their replacements.
+        static bool coreProfile;
+        // Whether the context can save and restore linked programs, needs
+        // GL 4.1 or ARB_get_program_binary and at least one binary format
+        static bool BinariesSupported();
+        // Set to have programs linked from now on keep their binaries
+        static bool retrievableBinaries;
     
         GLuint programID;
     
@@ -35,7 +52,23 @@ class ShaderProgram {
 	
         GLuint positionAttribute;
         GLuint texCoordAttribute;
+        // Per-sprite inputs of vertex_textured.glsl, -1 in other shaders
+        GLuint instanceTransformAttribute;
+        GLuint instanceRotationAttribute;
+        GLuint instanceUvAttribute;
+        GLuint instanceTintAttribute;
     
         GLuint vertexShader;
         GLuint fragmentShader;
+    
+        // Last values sent to each uniform, so repeats skip the upload
+        glm::mat4 modelMatrix;
+        glm::mat4 projectionMatrix;
+        glm::mat4 viewMatrix;
+        glm::vec4 color;
+        unsigned uploadedUniforms;
+    
+    private:
+        void FindLocations();
+        bool NeedsUpload(unsigned uniform, bool unchanged);
 };
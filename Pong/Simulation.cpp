@@ -0,0 +1,314 @@
+#include "Simulation.h"
+#include "Collision.h"
+#include "GameClock.h"
+#include "glm/common.hpp"
+#include <math.h>
+
+// No fused multiply-adds, so MatchBatch can match step() bit for bit
+#if defined(__clang__)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+void reset_match(MatchState &state, const glm::vec3 &movement_ball)
+{
+    state.position_left_pad  = glm::vec3(0.0f, 0.0f, 0.0f);
+    state.position_right_pad = glm::vec3(0.0f, 0.0f, 0.0f);
+    state.position_ball      = glm::vec3(0.0f, 0.0f, 0.0f);
+    state.movement_ball      = movement_ball;
+    state.rot_angle   = 0.0f;
+    state.paddle_hits = 0;
+    state.end_game    = false;
+    state.winner      = 0;
+}
+
+MatchState interpolate_match(const MatchState &previous, const MatchState &current, float alpha)
+{
+    MatchState state = current;
+    state.position_left_pad  = glm::mix(previous.position_left_pad, current.position_left_pad, alpha);
+    state.position_right_pad = glm::mix(previous.position_right_pad, current.position_right_pad, alpha);
+    state.position_ball      = glm::mix(previous.position_ball, current.position_ball, alpha);
+    // Take the short way round when the angle wrapped between the two
+    float turn = current.rot_angle - previous.rot_angle;
+    if (turn > 180.0f) { turn -= 360.0f; }
+    else if (turn < -180.0f) { turn += 360.0f; }
+    state.rot_angle = (float) wrap_degrees(previous.rot_angle + turn * alpha);
+    return state;
+}
+
+bool is_out_of_bound(const glm::vec3 &init_position, const glm::vec3 &position,
+                     const glm::vec3 &scale_vector)
+{
+    float boundary_limit = FIELD_HALF_HEIGHT - 0.5f * scale_vector.y;
+    glm::vec3 curr_position = init_position + position;
+    if (curr_position.y <= -boundary_limit or curr_position.y >= boundary_limit)
+    { return true; }
+    else { return false; }
+}
+
+bool ball_hits_vertical_wall(const glm::vec3 &init_position, const glm::vec3 &position)
+{
+    float boundary_limit = FIELD_HALF_WIDTH - 0.5f * SIZE_BALL.x;
+    glm::vec3 curr_position = init_position + position;
+    if (curr_position.x <= -boundary_limit or curr_position.x >= boundary_limit)
+    { return true; }
+    else { return false; }
+}
+
+bool collided(const glm::vec3 &position_a, const glm::vec3 &position_b,
+              const glm::vec3 &init_position_a, const glm::vec3 &init_position_b,
+              const glm::vec3 &size_vec_a, const glm::vec3 &size_vec_b)
+{
+    // Collision factor
+    float collision_factor = 1.0f;
+    // Get current position
+    glm::vec3 curr_position_a = init_position_a + position_a;
+    glm::vec3 curr_position_b = init_position_b + position_b;
+    // Get x_ and y_distances
+    float x_distance = fabs(curr_position_a.x - curr_position_b.x) - (collision_factor * (size_vec_a.x + size_vec_b.x) / 2.0f);
+    float y_distance = fabs(curr_position_a.y - curr_position_b.y) - (collision_factor * (size_vec_a.y + size_vec_b.y) / 2.0f);
+
+    if (x_distance < 0 && y_distance < 0)
+    { return true; }
+    else { return false; }
+}
+
+// Moves a paddle and stops it exactly at the wall, so step() and
+// simulate_events() agree on where it ends up
+static void slide_paddle(const glm::vec3 &init_position, glm::vec3 &position,
+                         float direction, float delta_time)
+{
+    float pad_bound = FIELD_HALF_HEIGHT - 0.5f * SIZE_PADDLE.y;
+    float y = init_position.y + position.y + direction * SPEED_PAD * delta_time;
+    y = fmaxf(-pad_bound, fminf(pad_bound, y));
+    position.y = y - init_position.y;
+}
+
+// Contacts the ball can make
+enum BallEvent { EVENT_NONE, EVENT_GOAL, EVENT_WALL, EVENT_PADDLE };
+
+// Time of impact of the ball centre with the line at +-bound, as a fraction
+// of the move. Only counts the side the ball is moving towards.
+static bool wall_time(float position, float move, float bound, float &time)
+{
+    if (move == 0.0f) { return false; }
+    float target = move > 0.0f ? bound : -bound;
+    time = (target - position) / move;
+    if (time > 1.0f) { return false; }
+    if (time < 0.0f) { time = 0.0f; }
+    return true;
+}
+
+// First contact of the ball while it moves by move and the paddles move by
+// pad_moves from pad_positions (absolute). time is a fraction of the move.
+static BallEvent next_ball_event(const glm::vec3 &ball, const glm::vec3 &movement_ball,
+                                 const glm::vec3 &move, const glm::vec3 pad_positions[2],
+                                 const glm::vec3 pad_moves[2], float &first_time, SweptHit &first_hit)
+{
+    float goal_bound = FIELD_HALF_WIDTH - 0.5f * SIZE_BALL.x;
+    float wall_bound = FIELD_HALF_HEIGHT - 0.5f * SIZE_BALL.y;
+
+    first_time = 1.0f;
+    BallEvent first = EVENT_NONE;
+    float time;
+    if (wall_time(ball.x, move.x, goal_bound, time) and time <= first_time)
+    { first_time = time; first = EVENT_GOAL; }
+    if (wall_time(ball.y, move.y, wall_bound, time) and time < first_time)
+    { first_time = time; first = EVENT_WALL; }
+
+    Aabb ball_box = { ball.x, ball.y, 0.5f * SIZE_BALL.x, 0.5f * SIZE_BALL.y };
+    for (int p = 0; p < 2; p++)
+    {
+        Aabb pad_box = { pad_positions[p].x, pad_positions[p].y, 0.5f * SIZE_PADDLE.x, 0.5f * SIZE_PADDLE.y };
+        SweptHit hit;
+        if (!swept_aabb(ball_box, move.x, move.y, pad_box, pad_moves[p].x, pad_moves[p].y, hit)) { continue; }
+        // A ball caught inside a paddle (squeezed against a wall, say) always
+        // leaves through the side, otherwise it could bounce between the two
+        if (hit.started_inside)
+        {
+            hit.normal_x = ball.x < pad_positions[p].x ? -1.0f : 1.0f;
+            hit.normal_y = 0.0f;
+        }
+        // A paddle running over the ball from above or below pushes it out
+        // through the side, as a tick landing the paddle on it would
+        bool heading_away = hit.normal_x * movement_ball.x + hit.normal_y * movement_ball.y > 0.0f;
+        if (heading_away and hit.normal_y != 0.0f)
+        {
+            float contact_x = ball.x + move.x * hit.time;
+            float pad_x = pad_positions[p].x + pad_moves[p].x * hit.time;
+            hit.normal_x = contact_x < pad_x ? -1.0f : 1.0f;
+            hit.normal_y = 0.0f;
+            heading_away = hit.normal_x * movement_ball.x > 0.0f;
+        }
+        if (!heading_away and hit.time < first_time)
+        {
+            first_time = hit.time;
+            first = EVENT_PADDLE;
+            first_hit = hit;
+        }
+    }
+    return first;
+}
+
+// Scores, bounces or reflects the ball off a paddle
+static void apply_ball_event(MatchState &state, BallEvent event, const glm::vec3 &ball, const SweptHit &hit)
+{
+    glm::vec3 &movement_ball = state.movement_ball;
+    if (event == EVENT_GOAL)
+    {
+        state.end_game = true;
+        state.winner = ball.x < 0 ? 2 : 1;
+    }
+    else if (event == EVENT_WALL)
+    {
+        movement_ball = glm::vec3(movement_ball.x, -movement_ball.y, 0.0f);
+    }
+    else if (event == EVENT_PADDLE)
+    {
+        // Side faces send the ball back, top and bottom faces deflect it
+        if (hit.normal_x != 0.0f)
+        { movement_ball = glm::vec3(fabs(movement_ball.x) * hit.normal_x, movement_ball.y, 0.0f); }
+        else
+        { movement_ball = glm::vec3(movement_ball.x, fabs(movement_ball.y) * hit.normal_y, 0.0f); }
+        state.paddle_hits++;
+    }
+}
+
+void step(MatchState &state, const MatchInput &input, float delta_time)
+{
+    if (state.end_game) { return; }
+
+    // Paddles move first, the ball is swept against where they travel
+    glm::vec3 pad_starts[2] = { INIT_POSITION_LEFT_PAD + state.position_left_pad,
+                                INIT_POSITION_RIGHT_PAD + state.position_right_pad };
+    slide_paddle(INIT_POSITION_LEFT_PAD, state.position_left_pad, input.left_pad, delta_time);
+    slide_paddle(INIT_POSITION_RIGHT_PAD, state.position_right_pad, input.right_pad, delta_time);
+    glm::vec3 pad_steps[2] = { INIT_POSITION_LEFT_PAD + state.position_left_pad - pad_starts[0],
+                               INIT_POSITION_RIGHT_PAD + state.position_right_pad - pad_starts[1] };
+
+    glm::vec3 ball = INIT_POSITION_BALL + state.position_ball;
+
+    // Walk the step from contact to contact, reflecting at each one
+    float elapsed = 0.0f;
+    for (int event = 0; event < MAX_EVENTS_PER_STEP and elapsed < 1.0f; event++)
+    {
+        float remaining = 1.0f - elapsed;
+        glm::vec3 move = state.movement_ball * SPEED_BALL * (delta_time * remaining);
+        glm::vec3 pad_positions[2], pad_moves[2];
+        for (int p = 0; p < 2; p++)
+        {
+            pad_positions[p] = pad_starts[p] + pad_steps[p] * elapsed;
+            pad_moves[p] = pad_steps[p] * remaining;
+        }
+
+        float time;
+        SweptHit hit = { 1.0f, 0.0f, 0.0f, false };
+        BallEvent first = next_ball_event(ball, state.movement_ball, move, pad_positions, pad_moves, time, hit);
+
+        // Move up to the contact
+        ball += move * time;
+        elapsed += remaining * time;
+
+        if (first == EVENT_NONE) { break; }
+        apply_ball_event(state, first, ball, hit);
+        if (state.end_game) { break; }
+    }
+    state.position_ball = ball - INIT_POSITION_BALL;
+
+    // Rotate ball
+    state.rot_angle = (float) wrap_degrees(state.rot_angle + ROT_SPEED_BALL * delta_time);
+}
+
+// Paddle velocity along y for this input, 0 when it is pushed against a wall
+static float paddle_velocity(float position_y, float direction, float bound)
+{
+    float velocity = direction * SPEED_PAD;
+    if ((velocity > 0.0f and position_y >= bound) or (velocity < 0.0f and position_y <= -bound))
+    { return 0.0f; }
+    return velocity;
+}
+
+int simulate_events(MatchState &state, double &time, const InputChange *changes,
+                    size_t change_count, double end_time)
+{
+    float pad_bound = FIELD_HALF_HEIGHT - 0.5f * SIZE_PADDLE.y;
+    glm::vec3 *pad_offsets[2] = { &state.position_left_pad, &state.position_right_pad };
+    const glm::vec3 pad_inits[2] = { INIT_POSITION_LEFT_PAD, INIT_POSITION_RIGHT_PAD };
+
+    // Input in effect right now
+    MatchInput input = { 0.0f, 0.0f };
+    size_t next_change = 0;
+    while (next_change < change_count and changes[next_change].time <= time)
+    {
+        input = changes[next_change++].input;
+    }
+
+    int events = 0;
+    while (!state.end_game and time < end_time and events < MAX_EVENTS_PER_CALL)
+    {
+        // Nothing changes course before the next input change or end_time
+        double horizon_end = end_time;
+        if (next_change < change_count and changes[next_change].time < horizon_end)
+        {
+            horizon_end = changes[next_change].time;
+        }
+        float horizon = (float) (horizon_end - time);
+        bool paddle_stops = false;
+
+        // Paddles stopping at a wall also end the straight-line segment
+        float directions[2] = { input.left_pad, input.right_pad };
+        float velocities[2];
+        glm::vec3 pad_positions[2];
+        for (int p = 0; p < 2; p++)
+        {
+            pad_positions[p] = pad_inits[p] + *pad_offsets[p];
+            velocities[p] = paddle_velocity(pad_positions[p].y, directions[p], pad_bound);
+            if (velocities[p] != 0.0f)
+            {
+                float stop = ((velocities[p] > 0.0f ? pad_bound : -pad_bound) - pad_positions[p].y) / velocities[p];
+                if (stop < horizon) { horizon = stop; paddle_stops = true; }
+            }
+        }
+
+        glm::vec3 ball = INIT_POSITION_BALL + state.position_ball;
+        glm::vec3 move = state.movement_ball * SPEED_BALL * horizon;
+        glm::vec3 pad_moves[2] = { glm::vec3(0.0f, velocities[0] * horizon, 0.0f),
+                                   glm::vec3(0.0f, velocities[1] * horizon, 0.0f) };
+        float fraction;
+        SweptHit hit = { 1.0f, 0.0f, 0.0f, false };
+        BallEvent first = next_ball_event(ball, state.movement_ball, move, pad_positions, pad_moves, fraction, hit);
+
+        // Jump straight to the event
+        float delta_time = horizon * fraction;
+        for (int p = 0; p < 2; p++)
+        {
+            float y = fmaxf(-pad_bound, fminf(pad_bound, pad_positions[p].y + velocities[p] * delta_time));
+            pad_offsets[p]->y = y - pad_inits[p].y;
+        }
+        ball += move * fraction;
+        state.position_ball = ball - INIT_POSITION_BALL;
+        state.rot_angle = (float) wrap_degrees(state.rot_angle + ROT_SPEED_BALL * delta_time);
+        // Land exactly on the input change so it is picked up below
+        time = (first == EVENT_NONE and !paddle_stops) ? horizon_end : time + delta_time;
+        events++;
+
+        apply_ball_event(state, first, ball, hit);
+        while (next_change < change_count and changes[next_change].time <= time)
+        {
+            input = changes[next_change++].input;
+        }
+    }
+    return events;
+}
+
+size_t step_batch(MatchState *states, const MatchInput *inputs, size_t count, float delta_time)
+{
+    size_t running = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        step(states[i], inputs[i], delta_time);
+        if (!states[i].end_game) { running++; }
+    }
+    return running;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "glm/vec3.hpp"
+#include <stddef.h>
+
+// Playfield half extents, matches the orthographic projection in main.cpp
+const float FIELD_HALF_WIDTH  = 5.0f,
+            FIELD_HALF_HEIGHT = 3.75f;
+
+// Initial positions
+const glm::vec3 INIT_POSITION_LEFT_PAD (-3.5f, 0.0f, 0.0f),
+                INIT_POSITION_RIGHT_PAD (3.5f, 0.0f, 0.0f),
+                INIT_POSITION_BALL (0.0f, 0.0f, 0.0f);
+
+// Sizes
+const glm::vec3 SIZE_PADDLE = glm::vec3(1.75f, 3.5f, 1.0f),
+                SIZE_BALL = glm::vec3(0.5f, 0.5f, 0.5f);
+
+// Ball is initialized to move to the left corner
+const glm::vec3 INIT_MOVEMENT_BALL = glm::vec3(-1.0f, -0.5f, 0.0f);
+
+// Speed
+const float SPEED_PAD = 4.0f,
+            SPEED_BALL = 3.5f,
+            ROT_SPEED_BALL = 45.f;
+
+// Everything needed to advance one match. Positions are offsets from the
+// matching INIT_POSITION_* constant, like the old globals in main.cpp.
+struct MatchState
+{
+    glm::vec3   position_left_pad,
+                position_right_pad,
+                position_ball;
+    glm::vec3   movement_ball;
+    float       rot_angle;      // degrees, every step keeps it in [0, 360)
+    int         paddle_hits;
+    bool        end_game;
+    int         winner;
+};
+
+// Paddle directions for one step: 1 moves up, -1 moves down, 0 stays
+struct MatchInput
+{
+    float left_pad;
+    float right_pad;
+};
+
+// Puts a match back at kick-off
+void reset_match(MatchState &state, const glm::vec3 &movement_ball = INIT_MOVEMENT_BALL);
+
+// Blends two consecutive states for drawing between fixed steps. alpha is 0
+// at previous and 1 at current; everything but the positions and rotation
+// comes from current.
+MatchState interpolate_match(const MatchState &previous, const MatchState &current, float alpha);
+
+// Most contacts resolved within one step before the rest of it is dropped
+const int MAX_EVENTS_PER_STEP = 8;
+
+// Advances one match by delta_time seconds. Does nothing once end_game is set.
+// The ball is swept against walls and moving paddles and reflected at the
+// exact time of contact, so large steps cannot tunnel through a paddle.
+void step(MatchState &state, const MatchInput &input, float delta_time);
+
+// Paddle input that takes effect at a given match time, in seconds
+struct InputChange
+{
+    double time;
+    MatchInput input;
+};
+
+// Safety cap on the number of segments simulate_events() walks per call
+const int MAX_EVENTS_PER_CALL = 1 << 20;
+
+// Event-driven alternative to calling step() every frame. Between contacts
+// the ball and paddles move in straight lines, so the match jumps from one
+// wall, paddle, goal, paddle-stop or input change to the next. changes must
+// be sorted by time. Runs until end_time or a goal, advances time, and
+// returns the number of segments processed.
+int simulate_events(MatchState &state, double &time, const InputChange *changes,
+                    size_t change_count, double end_time);
+
+// Advances count independent matches by delta_time seconds each and returns
+// how many of them are still running afterwards
+size_t step_batch(MatchState *states, const MatchInput *inputs, size_t count, float delta_time);
+
+// Checks whether objects hit the upper and lower walls
+bool is_out_of_bound(const glm::vec3 &init_position, const glm::vec3 &position,
+                     const glm::vec3 &scale_vector);
+
+// Checks whether ball hits left or right wall
+bool ball_hits_vertical_wall(const glm::vec3 &init_position, const glm::vec3 &position);
+
+// Detects collision
+bool collided(const glm::vec3 &position_a, const glm::vec3 &position_b,
+              const glm::vec3 &init_position_a, const glm::vec3 &init_position_b,
+              const glm::vec3 &size_vec_a, const glm::vec3 &size_vec_b);
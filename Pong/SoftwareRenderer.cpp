@@ -0,0 +1,463 @@
+#include "SoftwareRenderer.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// x * 255 / 255 rounded, exact for x up to 65535
+static inline uint32_t divide_255(uint32_t x)
+{
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+// GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA on all four channels
+static inline uint32_t blend_pixel(uint32_t source, uint32_t target)
+{
+    uint32_t alpha = source >> 24;
+    uint32_t result = 0;
+    for (int shift = 0; shift < 32; shift += 8)
+    {
+        uint32_t s = (source >> shift) & 0xFF, t = (target >> shift) & 0xFF;
+        result |= divide_255(s * alpha + t * (255 - alpha)) << shift;
+    }
+    return result;
+}
+
+static inline uint32_t sample(const uint32_t *texels, int texture_width, int texture_height, float u, float v)
+{
+    // Clamped before truncating, which then floors as coordinates are >= 0
+    u = std::min(std::max(u, 0.0f), (float) (texture_width - 1));
+    v = std::min(std::max(v, 0.0f), (float) (texture_height - 1));
+    return texels[(int) v * texture_width + (int) u];
+}
+
+// Pixels first..count of a span. Every path works out pixel k as
+// u + k * step_u so they agree bit for bit.
+static void blend_span_scalar(uint32_t *target, int first, int count, float u, float v, float step_u,
+                              float step_v, const uint32_t *texels, int texture_width, int texture_height)
+{
+    for (int k = first; k < count; k++)
+    {
+        uint32_t source = sample(texels, texture_width, texture_height, u + (float) k * step_u, v + (float) k * step_v);
+        target[k] = blend_pixel(source, target[k]);
+    }
+}
+
+static void span_scalar(uint32_t *target, int count, float u, float v, float step_u, float step_v,
+                        const uint32_t *texels, int texture_width, int texture_height)
+{
+    blend_span_scalar(target, 0, count, u, v, step_u, step_v, texels, texture_width, texture_height);
+}
+
+// Tinted sprites are rare, so they only get the scalar loop
+static void span_tinted(uint32_t *target, int count, float u, float v, float step_u, float step_v,
+                        const uint32_t *texels, int texture_width, int texture_height, SpriteTint tint)
+{
+    const uint32_t factors[4] = { tint.r, tint.g, tint.b, tint.a };
+    for (int k = 0; k < count; k++)
+    {
+        uint32_t texel = sample(texels, texture_width, texture_height, u + (float) k * step_u, v + (float) k * step_v);
+        uint32_t source = 0;
+        for (int channel = 0; channel < 4; channel++)
+        {
+            uint32_t value = (texel >> (channel * 8)) & 0xFF;
+            source |= divide_255(value * factors[channel]) << (channel * 8);
+        }
+        target[k] = blend_pixel(source, target[k]);
+    }
+}
+
+#ifdef __SSE2__
+// Blends four pixels, two at a time in 16-bit lanes
+static inline __m128i blend_sse2(__m128i source, __m128i target)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi16(255);
+    const __m128i half = _mm_set1_epi16(128);
+    __m128i halves[2];
+    for (int h = 0; h < 2; h++)
+    {
+        __m128i s = h == 0 ? _mm_unpacklo_epi8(source, zero) : _mm_unpackhi_epi8(source, zero);
+        __m128i t = h == 0 ? _mm_unpacklo_epi8(target, zero) : _mm_unpackhi_epi8(target, zero);
+        __m128i alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+        __m128i sum = _mm_add_epi16(_mm_mullo_epi16(s, alpha), _mm_mullo_epi16(t, _mm_sub_epi16(max, alpha)));
+        sum = _mm_add_epi16(sum, half);
+        halves[h] = _mm_srli_epi16(_mm_add_epi16(sum, _mm_srli_epi16(sum, 8)), 8);
+    }
+    return _mm_packus_epi16(halves[0], halves[1]);
+}
+
+// No gather before AVX2, so texel addresses go through memory
+static void span_sse2(uint32_t *target, int count, float u, float v, float step_u, float step_v,
+                      const uint32_t *texels, int texture_width, int texture_height)
+{
+    const __m128 lanes = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 max_u = _mm_set1_ps((float) (texture_width - 1));
+    const __m128 max_v = _mm_set1_ps((float) (texture_height - 1));
+    int k = 0;
+    for (; k + 4 <= count; k += 4)
+    {
+        __m128 index = _mm_add_ps(_mm_set1_ps((float) k), lanes);
+        __m128 us = _mm_add_ps(_mm_set1_ps(u), _mm_mul_ps(index, _mm_set1_ps(step_u)));
+        __m128 vs = _mm_add_ps(_mm_set1_ps(v), _mm_mul_ps(index, _mm_set1_ps(step_v)));
+        alignas(16) int32_t xs[4], ys[4];
+        _mm_store_si128((__m128i*) xs, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(us, zero), max_u)));
+        _mm_store_si128((__m128i*) ys, _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(vs, zero), max_v)));
+        __m128i source = _mm_set_epi32((int) texels[ys[3] * texture_width + xs[3]], (int) texels[ys[2] * texture_width + xs[2]],
+                                       (int) texels[ys[1] * texture_width + xs[1]], (int) texels[ys[0] * texture_width + xs[0]]);
+        __m128i *pixels = (__m128i*) (target + k);
+        _mm_storeu_si128(pixels, blend_sse2(source, _mm_loadu_si128(pixels)));
+    }
+    blend_span_scalar(target, k, count, u, v, step_u, step_v, texels, texture_width, texture_height);
+}
+#endif
+
+#ifdef POKEPONG_X86_DISPATCH
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+AVX2_FUNCTION static inline __m256i blend_avx2(__m256i source, __m256i target)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi16(255);
+    const __m256i half = _mm256_set1_epi16(128);
+    __m256i halves[2];
+    for (int h = 0; h < 2; h++)
+    {
+        __m256i s = h == 0 ? _mm256_unpacklo_epi8(source, zero) : _mm256_unpackhi_epi8(source, zero);
+        __m256i t = h == 0 ? _mm256_unpacklo_epi8(target, zero) : _mm256_unpackhi_epi8(target, zero);
+        __m256i alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+        __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(s, alpha), _mm256_mullo_epi16(t, _mm256_sub_epi16(max, alpha)));
+        sum = _mm256_add_epi16(sum, half);
+        halves[h] = _mm256_srli_epi16(_mm256_add_epi16(sum, _mm256_srli_epi16(sum, 8)), 8);
+    }
+    // Unpack and pack both work within 128-bit lanes, so pixel order holds
+    return _mm256_packus_epi16(halves[0], halves[1]);
+}
+
+AVX2_FUNCTION static void span_avx2(uint32_t *target, int count, float u, float v, float step_u, float step_v,
+                                  const uint32_t *texels, int texture_width, int texture_height)
+{
+    const __m256 lanes = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 max_u = _mm256_set1_ps((float) (texture_width - 1));
+    const __m256 max_v = _mm256_set1_ps((float) (texture_height - 1));
+    const __m256i row = _mm256_set1_epi32(texture_width);
+    int k = 0;
+    for (; k + 8 <= count; k += 8)
+    {
+        __m256 index = _mm256_add_ps(_mm256_set1_ps((float) k), lanes);
+        __m256 us = _mm256_add_ps(_mm256_set1_ps(u), _mm256_mul_ps(index, _mm256_set1_ps(step_u)));
+        __m256 vs = _mm256_add_ps(_mm256_set1_ps(v), _mm256_mul_ps(index, _mm256_set1_ps(step_v)));
+        __m256i xs = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(us, zero), max_u));
+        __m256i ys = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(vs, zero), max_v));
+        __m256i source = _mm256_i32gather_epi32((const int*) texels, _mm256_add_epi32(_mm256_mullo_epi32(ys, row), xs), 4);
+        __m256i *pixels = (__m256i*) (target + k);
+        _mm256_storeu_si256(pixels, blend_avx2(source, _mm256_loadu_si256(pixels)));
+    }
+    blend_span_scalar(target, k, count, u, v, step_u, step_v, texels, texture_width, texture_height);
+}
+#endif
+
+SoftwareRenderer::SoftwareRenderer()
+    : width(0), height(0), simd_level(SIMD_SCALAR), frames(0), sprites_drawn(0),
+      view_projection(1.0f), clear_color(0), tiles_x(0), tiles_y(0), span(span_scalar),
+      generation(0), stopping(false), busy_workers(0), next_tile(0)
+{
+}
+
+SoftwareRenderer::~SoftwareRenderer()
+{
+    Cleanup();
+}
+
+void SoftwareRenderer::Initialise(int framebuffer_width, int framebuffer_height, int threads)
+{
+    width = framebuffer_width;
+    height = framebuffer_height;
+    framebuffer.assign((size_t) width * height, clear_color);
+    tiles_x = (width + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    tiles_y = (height + SOFTWARE_TILE_SIZE - 1) / SOFTWARE_TILE_SIZE;
+    bins.assign(tiles_x * tiles_y, std::vector<size_t>());
+
+    simd_level = detect_simd_level();
+    span = span_scalar;
+#ifdef POKEPONG_X86_DISPATCH
+    if (simd_level == SIMD_AVX2) { span = span_avx2; }
+#endif
+#ifdef __SSE2__
+    if (simd_level == SIMD_SSE2) { span = span_sse2; }
+#endif
+
+    if (threads <= 0) { threads = (int) std::thread::hardware_concurrency(); }
+    threads = std::min(std::max(threads, 1), SOFTWARE_MAX_THREADS);
+    stopping = false;
+    // The calling thread rasterises too
+    for (int i = 1; i < threads; i++) { workers.push_back(std::thread(&SoftwareRenderer::WorkerLoop, this)); }
+}
+
+void SoftwareRenderer::Cleanup()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread &worker : workers) { worker.join(); }
+    workers.clear();
+}
+
+int SoftwareRenderer::AddTexture(const unsigned char *pixels, int texture_width, int texture_height)
+{
+    Texture texture;
+    texture.width = texture_width;
+    texture.height = texture_height;
+    texture.texels.resize((size_t) texture_width * texture_height);
+    memcpy(texture.texels.data(), pixels, texture.texels.size() * sizeof(uint32_t));
+    textures.push_back(texture);
+    return (int) textures.size() - 1;
+}
+
+void SoftwareRenderer::SetViewProjection(const glm::mat4 &matrix)
+{
+    view_projection = matrix;
+}
+
+void SoftwareRenderer::SetClearColor(float r, float g, float b, float a)
+{
+    const float channels[4] = { r, g, b, a };
+    clear_color = 0;
+    for (int channel = 0; channel < 4; channel++)
+    {
+        float value = std::min(std::max(channels[channel], 0.0f), 1.0f);
+        clear_color |= (uint32_t) (value * 255.0f + 0.5f) << (channel * 8);
+    }
+}
+
+void SoftwareRenderer::Begin()
+{
+    sprites.clear();
+}
+
+void SoftwareRenderer::Draw(int texture, SpriteLayer layer, const glm::vec3 &position, const glm::vec3 &size,
+                            const UvRect &uv, float rotation, const SpriteTint &tint)
+{
+    // Where quad points land in pixels, row 0 at the top
+    float radians = rotation * 3.14159265358979f / 180.0f;
+    float c = cosf(radians), s = sinf(radians);
+    glm::vec2 pixels[3];
+    const float locals[3][2] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 0.0f, 1.0f } };
+    for (int i = 0; i < 3; i++)
+    {
+        float x = locals[i][0] * size.x, y = locals[i][1] * size.y;
+        glm::vec4 clip = view_projection * glm::vec4(position.x + c * x - s * y, position.y + s * x + c * y, 0.0f, 1.0f);
+        pixels[i] = glm::vec2((clip.x + 1.0f) * 0.5f * width, (1.0f - clip.y) * 0.5f * height);
+    }
+    glm::vec2 centre = pixels[0], axis_x = pixels[1] - centre, axis_y = pixels[2] - centre;
+    float determinant = axis_x.x * axis_y.y - axis_y.x * axis_x.y;
+    if (fabsf(determinant) < 1e-12f) { return; }
+
+    Sprite sprite;
+    sprite.layer = layer;
+    sprite.order = sprites.size();
+    sprite.texture = texture;
+    sprite.tint = tint;
+    // Inverse of the quad-to-pixel mapping
+    sprite.local_x[0] = axis_y.y / determinant;
+    sprite.local_x[1] = -axis_y.x / determinant;
+    sprite.local_x[2] = -(sprite.local_x[0] * centre.x + sprite.local_x[1] * centre.y);
+    sprite.local_y[0] = -axis_x.y / determinant;
+    sprite.local_y[1] = axis_x.x / determinant;
+    sprite.local_y[2] = -(sprite.local_y[0] * centre.x + sprite.local_y[1] * centre.y);
+    // u runs left to right, v from the top edge down, as in the shader
+    int texture_width = textures[texture].width, texture_height = textures[texture].height;
+    float span_u = (uv.u1 - uv.u0) * texture_width, span_v = (uv.v1 - uv.v0) * texture_height;
+    for (int i = 0; i < 3; i++)
+    {
+        sprite.texel_u[i] = span_u * sprite.local_x[i];
+        sprite.texel_v[i] = -span_v * sprite.local_y[i];
+    }
+    sprite.texel_u[2] += (uv.u0 + 0.5f * (uv.u1 - uv.u0)) * texture_width;
+    sprite.texel_v[2] += (uv.v0 + 0.5f * (uv.v1 - uv.v0)) * texture_height;
+
+    float min_x = (float) width, min_y = (float) height, max_x = 0.0f, max_y = 0.0f;
+    for (int corner = 0; corner < 4; corner++)
+    {
+        float lx = corner & 1 ? 0.5f : -0.5f, ly = corner & 2 ? 0.5f : -0.5f;
+        glm::vec2 point = centre + axis_x * lx + axis_y * ly;
+        min_x = std::min(min_x, point.x);
+        min_y = std::min(min_y, point.y);
+        max_x = std::max(max_x, point.x);
+        max_y = std::max(max_y, point.y);
+    }
+    sprite.min_x = std::max((int) floorf(min_x), 0);
+    sprite.min_y = std::max((int) floorf(min_y), 0);
+    sprite.max_x = std::min((int) ceilf(max_x), width);
+    sprite.max_y = std::min((int) ceilf(max_y), height);
+    if (sprite.min_x >= sprite.max_x or sprite.min_y >= sprite.max_y) { return; }
+    sprites.push_back(sprite);
+}
+
+bool SoftwareRenderer::DrawsBefore(const Sprite &a, const Sprite &b)
+{
+    if (a.layer != b.layer) { return a.layer < b.layer; }
+    return a.order < b.order;
+}
+
+void SoftwareRenderer::End()
+{
+    TRACE_ZONE("SoftwareRenderer::End");
+    std::sort(sprites.begin(), sprites.end(), DrawsBefore);
+    for (std::vector<size_t> &bin : bins) { bin.clear(); }
+    for (size_t i = 0; i < sprites.size(); i++)
+    {
+        const Sprite &sprite = sprites[i];
+        for (int ty = sprite.min_y / SOFTWARE_TILE_SIZE; ty <= (sprite.max_y - 1) / SOFTWARE_TILE_SIZE; ty++)
+        {
+            for (int tx = sprite.min_x / SOFTWARE_TILE_SIZE; tx <= (sprite.max_x - 1) / SOFTWARE_TILE_SIZE; tx++)
+            {
+                bins[ty * tiles_x + tx].push_back(i);
+            }
+        }
+    }
+
+    next_tile.store(0);
+    if (workers.empty()) { RasterTiles(); }
+    else
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            busy_workers = (int) workers.size();
+            generation++;
+        }
+        wake.notify_all();
+        RasterTiles();
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return busy_workers == 0; });
+    }
+    frames++;
+    sprites_drawn += sprites.size();
+}
+
+void SoftwareRenderer::WorkerLoop()
+{
+#ifdef POKEPONG_TRACE
+    trace_set_thread_name("raster");
+#endif
+    uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping or generation != seen; });
+            if (stopping) { return; }
+            seen = generation;
+        }
+        RasterTiles();
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy_workers == 0) { finished.notify_one(); }
+    }
+}
+
+void SoftwareRenderer::RasterTiles()
+{
+    TRACE_ZONE("SoftwareRenderer::RasterTiles");
+    int tiles = tiles_x * tiles_y;
+    for (int tile = next_tile.fetch_add(1); tile < tiles; tile = next_tile.fetch_add(1)) { RasterTile(tile); }
+}
+
+void SoftwareRenderer::RasterTile(int tile)
+{
+    int x0 = (tile % tiles_x) * SOFTWARE_TILE_SIZE, y0 = (tile / tiles_x) * SOFTWARE_TILE_SIZE;
+    int x1 = std::min(x0 + SOFTWARE_TILE_SIZE, width), y1 = std::min(y0 + SOFTWARE_TILE_SIZE, height);
+    for (int y = y0; y < y1; y++)
+    {
+        std::fill(framebuffer.begin() + (size_t) y * width + x0, framebuffer.begin() + (size_t) y * width + x1, clear_color);
+    }
+    for (size_t index : bins[tile])
+    {
+        const Sprite &sprite = sprites[index];
+        RasterSprite(sprite, std::max(x0, sprite.min_x), std::max(y0, sprite.min_y),
+                     std::min(x1, sprite.max_x), std::min(y1, sprite.max_y));
+    }
+}
+
+// Narrows [first, last) to the x where a * x + k lies in [-0.5, 0.5)
+static void clip_span(float a, float k, int &first, int &last)
+{
+    if (fabsf(a) < 1e-12f)
+    {
+        if (k < -0.5f or k >= 0.5f) { last = first; }
+        return;
+    }
+    float low = (-0.5f - k) / a, high = (0.5f - k) / a;
+    if (a > 0.0f)
+    {
+        first = std::max(first, (int) ceilf(low));
+        last = std::min(last, (int) ceilf(high));
+    }
+    else
+    {
+        first = std::max(first, (int) floorf(high) + 1);
+        last = std::min(last, (int) floorf(low) + 1);
+    }
+}
+
+void SoftwareRenderer::RasterSprite(const Sprite &sprite, int x0, int y0, int x1, int y1)
+{
+    const Texture &texture = textures[sprite.texture];
+    bool tinted = sprite.tint.r != 255 or sprite.tint.g != 255 or sprite.tint.b != 255 or sprite.tint.a != 255;
+    for (int y = y0; y < y1; y++)
+    {
+        // Pixel centres sit at x + 0.5, y + 0.5
+        float centre_y = y + 0.5f;
+        float kx = sprite.local_x[0] * 0.5f + sprite.local_x[1] * centre_y + sprite.local_x[2];
+        float ky = sprite.local_y[0] * 0.5f + sprite.local_y[1] * centre_y + sprite.local_y[2];
+        int first = x0, last = x1;
+        clip_span(sprite.local_x[0], kx, first, last);
+        clip_span(sprite.local_y[0], ky, first, last);
+        if (first >= last) { continue; }
+
+        float centre_x = first + 0.5f;
+        float u = sprite.texel_u[0] * centre_x + sprite.texel_u[1] * centre_y + sprite.texel_u[2];
+        float v = sprite.texel_v[0] * centre_x + sprite.texel_v[1] * centre_y + sprite.texel_v[2];
+        uint32_t *target = framebuffer.data() + (size_t) y * width + first;
+        if (tinted)
+        {
+            span_tinted(target, last - first, u, v, sprite.texel_u[0], sprite.texel_v[0],
+                        texture.texels.data(), texture.width, texture.height, sprite.tint);
+        }
+        else
+        {
+            span(target, last - first, u, v, sprite.texel_u[0], sprite.texel_v[0],
+                 texture.texels.data(), texture.width, texture.height);
+        }
+    }
+}
+
+bool write_ppm(const char *path, const uint32_t *pixels, int width, int height, bool bottom_up)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) { return false; }
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    std::vector<unsigned char> row((size_t) width * 3);
+    for (int y = 0; y < height; y++)
+    {
+        const uint32_t *source = pixels + (size_t) (bottom_up ? height - 1 - y : y) * width;
+        for (int x = 0; x < width; x++)
+        {
+            row[x * 3 + 0] = source[x] & 0xFF;
+            row[x * 3 + 1] = (source[x] >> 8) & 0xFF;
+            row[x * 3 + 2] = (source[x] >> 16) & 0xFF;
+        }
+        fwrite(row.data(), 1, row.size(), file);
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "SpriteTypes.h"
+#include "glm/mat4x4.hpp"
+#include "glm/vec3.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Side of the square tiles the framebuffer is split into; each tile is
+// rasterised by one thread start to finish
+const int SOFTWARE_TILE_SIZE = 64;
+// Threads beyond this stop paying off at 640x480
+const int SOFTWARE_MAX_THREADS = 8;
+
+// Inner loop that samples and blends one horizontal run of pixels
+typedef void (*SpanFunction)(uint32_t *target, int count, float texel_u, float texel_v,
+                             float step_u, float step_v, const uint32_t *texels,
+                             int texture_width, int texture_height);
+
+// CPU rasteriser for the textured, alpha-blended quads render() draws.
+// Mirrors SpriteBatch's Begin/Draw/End with nearest sampling
+// and GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA blending, into an RGBA8
+// framebuffer, top row first. Tiles are shared out between worker
+// threads; spans use AVX2 or SSE2 where the CPU has them.
+class SoftwareRenderer {
+    public:
+        SoftwareRenderer();
+        ~SoftwareRenderer();
+
+        // threads 0 picks from the core count
+        void Initialise(int width, int height, int threads = 0);
+        void Cleanup();
+
+        // Copies an RGBA8 texture in and returns the id to draw it with
+        int AddTexture(const unsigned char *pixels, int width, int height);
+        // World to clip space, as the shaders' projection times view
+        void SetViewProjection(const glm::mat4 &matrix);
+        void SetClearColor(float r, float g, float b, float a);
+
+        void Begin();
+        void Draw(int texture, SpriteLayer layer, const glm::vec3 &position, const glm::vec3 &size,
+                  const UvRect &uv = FULL_UV_RECT, float rotation = 0.0f,
+                  const SpriteTint &tint = WHITE_TINT);
+        // Clears and rasterises everything queued since Begin()
+        void End();
+
+        // RGBA8, width * height, row 0 at the top
+        const uint32_t* Pixels() const { return framebuffer.data(); }
+
+        int width, height;
+        // Span kernel, POKEPONG_SIMD caps it like the simulation's
+        SimdLevel simd_level;
+        size_t frames;
+        size_t sprites_drawn;
+
+    private:
+        // A sprite resolved to pixel space. Each coefficient triple is a
+        // linear function a * x + b * y + c of a pixel centre.
+        struct Sprite
+        {
+            SpriteLayer layer;
+            size_t order;
+            int texture;
+            // Position inside the unit quad, covered where both are in [-0.5, 0.5)
+            float local_x[3], local_y[3];
+            // Texel coordinates to sample
+            float texel_u[3], texel_v[3];
+            // Pixel bounds, max exclusive
+            int min_x, min_y, max_x, max_y;
+            SpriteTint tint;
+        };
+
+        static bool DrawsBefore(const Sprite &a, const Sprite &b);
+        void WorkerLoop();
+        // Takes tiles off the shared counter until none are left
+        void RasterTiles();
+        void RasterTile(int tile);
+        void RasterSprite(const Sprite &sprite, int x0, int y0, int x1, int y1);
+
+        struct Texture
+        {
+            std::vector<uint32_t> texels;
+            int width, height;
+        };
+
+        std::vector<uint32_t> framebuffer;
+        std::vector<Texture> textures;
+        glm::mat4 view_projection;
+        uint32_t clear_color;
+
+        std::vector<Sprite> sprites;
+        // Indices into sprites touching each tile, in draw order
+        std::vector<std::vector<size_t>> bins;
+        int tiles_x, tiles_y;
+
+        SpanFunction span;
+
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable finished;
+        // Guarded by mutex
+        uint64_t generation;
+        bool stopping;
+        int busy_workers;
+        std::atomic<int> next_tile;
+};
+
+// Writes RGBA8 pixels as a binary PPM, dropping alpha. bottom_up is for
+// rows read back from GL, which start at the bottom.
+bool write_ppm(const char *path, const uint32_t *pixels, int width, int height, bool bottom_up = false);
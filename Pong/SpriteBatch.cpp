@@ -0,0 +1,197 @@
+#include "SpriteBatch.h"
+#include "GLStateCache.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <string.h>
+
+const float DEGREES_TO_RADIANS = 3.14159265358979f / 180.0f;
+
+SpriteBatch::SpriteBatch() : frames(0), instanced(false), capacity(0), corner_buffer(0),
+                             instance_offset(0)
+{
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    memset(&total_stats, 0, sizeof(total_stats));
+}
+
+void SpriteBatch::Initialise(size_t sprite_capacity, StreamStrategy strategy)
+{
+    quads.Initialise(sprite_capacity);
+    capacity = quads.capacity;
+    instanced = gl_has_instancing();
+    sprites.reserve(capacity);
+    instances.reserve(RecordCapacity());
+    uploaded.reserve(RecordCapacity());
+
+    // The unit quad, repeated for every sprite when drawing without
+    // instancing, texture v running down from the top edge
+    std::vector<Corner> corners(instanced ? QUAD_CORNERS : capacity * QUAD_CORNERS);
+    for (size_t i = 0; i < corners.size(); i++)
+    {
+        const float *unit = UNIT_QUAD_CORNERS[i % QUAD_CORNERS];
+        Corner corner = { unit[0], unit[1], unit[0] + 0.5f, 0.5f - unit[1] };
+        corners[i] = corner;
+    }
+    glGenBuffers(1, &corner_buffer);
+    gl_state().BindArrayBuffer(corner_buffer);
+    glBufferData(GL_ARRAY_BUFFER, corners.size() * sizeof(Corner), corners.data(), GL_STATIC_DRAW);
+
+    stream.Initialise(RecordCapacity() * sizeof(SpriteInstance), strategy);
+}
+
+void SpriteBatch::Cleanup()
+{
+    gl_state().ForgetBuffer(corner_buffer);
+    glDeleteBuffers(1, &corner_buffer);
+    corner_buffer = 0;
+    stream.Cleanup();
+    uploaded.clear();
+    quads.Cleanup();
+}
+
+void SpriteBatch::Begin()
+{
+    sprites.clear();
+}
+
+void SpriteBatch::Draw(ShaderProgram &program, GLuint texture, SpriteLayer layer,
+                       const glm::vec3 &position, const glm::vec3 &size,
+                       const UvRect &uv, float rotation, const SpriteTint &tint)
+{
+    // Full batches drop the sprite rather than grow the GL buffer mid-frame
+    if (sprites.size() >= capacity) { return; }
+    SpriteInstance instance = { position.x, position.y, size.x, size.y, rotation * DEGREES_TO_RADIANS, uv, tint };
+    Sprite sprite = { &program, texture, layer, sprites.size(), instance };
+    sprites.push_back(sprite);
+}
+
+size_t SpriteBatch::RecordCapacity() const
+{
+    // Without instancing every corner carries its sprite's record
+    return instanced ? capacity : capacity * QUAD_CORNERS;
+}
+
+bool SpriteBatch::DrawsBefore(const Sprite &a, const Sprite &b)
+{
+    if (a.layer != b.layer) { return a.layer < b.layer; }
+    if (a.program->programID != b.program->programID) { return a.program->programID < b.program->programID; }
+    if (a.texture != b.texture) { return a.texture < b.texture; }
+    // Keep submission order within a run
+    return a.order < b.order;
+}
+
+// Inputs a shader doesn't declare have location -1 and are skipped
+// Divisors are only touched when instancing, older contexts lack the call
+static void set_attribute(GLuint location, GLint size, GLenum type, bool normalized, GLsizei stride,
+                          size_t offset, bool instanced, GLuint divisor, uint32_t &enabled)
+{
+    if (location == (GLuint) -1) { return; }
+    glVertexAttribPointer(location, size, type, normalized, stride, (const void*) offset);
+    if (instanced) { glVertexAttribDivisor(location, divisor); }
+    enabled |= attribute_bit(location);
+}
+
+void SpriteBatch::SetupAttributes(ShaderProgram &program, size_t first)
+{
+    uint32_t enabled = 0;
+    gl_state().BindArrayBuffer(corner_buffer);
+    set_attribute(program.positionAttribute, 2, GL_FLOAT, false, sizeof(Corner),
+                  offsetof(Corner, x), instanced, 0, enabled);
+    set_attribute(program.texCoordAttribute, 2, GL_FLOAT, false, sizeof(Corner),
+                  offsetof(Corner, u), instanced, 0, enabled);
+
+    gl_state().BindArrayBuffer(stream.buffer);
+    size_t base = instance_offset + first * sizeof(SpriteInstance);
+    set_attribute(program.instanceTransformAttribute, 4, GL_FLOAT, false, sizeof(SpriteInstance),
+                  base + offsetof(SpriteInstance, x), instanced, 1, enabled);
+    set_attribute(program.instanceRotationAttribute, 1, GL_FLOAT, false, sizeof(SpriteInstance),
+                  base + offsetof(SpriteInstance, rotation), instanced, 1, enabled);
+    set_attribute(program.instanceUvAttribute, 4, GL_FLOAT, false, sizeof(SpriteInstance),
+                  base + offsetof(SpriteInstance, uv), instanced, 1, enabled);
+    set_attribute(program.instanceTintAttribute, 4, GL_UNSIGNED_BYTE, true, sizeof(SpriteInstance),
+                  base + offsetof(SpriteInstance, tint), instanced, 1, enabled);
+    gl_state().SetAttributes(enabled);
+    frame_stats.attribute_setups++;
+}
+
+void SpriteBatch::End()
+{
+    TRACE_ZONE("SpriteBatch::End");
+    memset(&frame_stats, 0, sizeof(frame_stats));
+    frames++;
+    if (sprites.empty()) { return; }
+
+    std::sort(sprites.begin(), sprites.end(), DrawsBefore);
+
+    // One record per sprite, the GPU does the placing
+    instances.clear();
+    for (const Sprite &sprite : sprites)
+    {
+        for (int c = 0; c < (instanced ? 1 : QUAD_CORNERS); c++) { instances.push_back(sprite.instance); }
+    }
+
+    quads.Bind();
+    // Still frames, paused or the winner screen, reuse what is there
+    bool unchanged = instances.size() == uploaded.size() and
+                     memcmp(instances.data(), uploaded.data(), instances.size() * sizeof(SpriteInstance)) == 0;
+    if (!unchanged)
+    {
+        instance_offset = stream.Write(instances.data(), instances.size() * sizeof(SpriteInstance));
+        uploaded = instances;
+        frame_stats.buffer_uploads++;
+    }
+    else { stream.Reuse(); }
+
+    // Layers only decide the order; a run spans them while the program and
+    // texture stay the same. Binds go through the state cache, so a program
+    // or texture still bound from last frame costs nothing.
+    ShaderProgram *program = NULL;
+    GLuint texture = 0;
+    bool texture_bound = false;
+    size_t first = 0;
+    for (size_t i = 1; i <= sprites.size(); i++)
+    {
+        bool run_ends = i == sprites.size() or
+                        sprites[i].program->programID != sprites[first].program->programID or
+                        sprites[i].texture != sprites[first].texture;
+        if (!run_ends) { continue; }
+
+        const Sprite &run = sprites[first];
+        if (program == NULL or program->programID != run.program->programID)
+        {
+            program = run.program;
+            gl_state().UseProgram(program->programID);
+            frame_stats.program_binds++;
+            if (!instanced) { SetupAttributes(*program, 0); }
+        }
+        if (!texture_bound or texture != run.texture)
+        {
+            texture = run.texture;
+            texture_bound = true;
+            gl_state().BindTexture(texture);
+            frame_stats.texture_binds++;
+        }
+        if (instanced)
+        {
+            // No base instance before GL 4.2, so the instance inputs are
+            // pointed at the run instead
+            SetupAttributes(*program, first);
+            glDrawElementsInstanced(GL_TRIANGLES, QUAD_INDICES, GL_UNSIGNED_SHORT, NULL, (GLsizei) (i - first));
+        }
+        else
+        {
+            glDrawElements(GL_TRIANGLES, (GLsizei) ((i - first) * QUAD_INDICES), GL_UNSIGNED_SHORT,
+                           (const void*) (first * QUAD_INDICES * sizeof(GLushort)));
+        }
+        frame_stats.draw_calls++;
+        first = i;
+    }
+    stream.EndFrame();
+
+    frame_stats.sprites = sprites.size();
+    total_stats.sprites += frame_stats.sprites;
+    total_stats.draw_calls += frame_stats.draw_calls;
+    total_stats.program_binds += frame_stats.program_binds;
+    total_stats.texture_binds += frame_stats.texture_binds;
+    total_stats.attribute_setups += frame_stats.attribute_setups;
+    total_stats.buffer_uploads += frame_stats.buffer_uploads;
+}
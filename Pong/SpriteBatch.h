@@ -0,0 +1,99 @@
+#pragma once
+
+#include "QuadGeometry.h"
+#include "ShaderProgram.h"
+#include "SpriteTypes.h"
+#include "StreamBuffer.h"
+#include "glm/vec3.hpp"
+#include <stddef.h>
+#include <vector>
+
+// Sprites one batch holds, the instance buffer is sized for this many
+const size_t SPRITE_BATCH_CAPACITY = 1024;
+
+// Everything vertex_textured.glsl needs to place one sprite
+struct SpriteInstance
+{
+    float x, y;
+    float width, height;
+    float rotation;
+    UvRect uv;
+    SpriteTint tint;
+};
+
+// GL work done by the last End(), and since Initialise(). A frame whose
+// instances match the last upload skips it.
+struct SpriteBatchStats
+{
+    size_t sprites;
+    size_t draw_calls;
+    size_t program_binds;
+    size_t texture_binds;
+    size_t attribute_setups;
+    size_t buffer_uploads;
+};
+
+// Collects sprites for a frame as compact instance records, streams them
+// into a StreamBuffer and lets vertex_textured.glsl expand each over a static
+// unit quad. Sprites are sorted by layer, then program, then texture, and
+// each run sharing a program and texture is one instanced draw. Without
+// GL 3.3 the same records are copied to every corner and drawn indexed.
+// Every program must have an identity model matrix.
+class SpriteBatch {
+    public:
+        SpriteBatch();
+
+        void Initialise(size_t capacity = SPRITE_BATCH_CAPACITY,
+                        StreamStrategy strategy = STREAM_PERSISTENT);
+        void Cleanup();
+
+        void Begin();
+        // Queues a size-by-size quad centred on position, rotated
+        // counter-clockwise by rotation degrees
+        void Draw(ShaderProgram &program, GLuint texture, SpriteLayer layer,
+                  const glm::vec3 &position, const glm::vec3 &size,
+                  const UvRect &uv = FULL_UV_RECT, float rotation = 0.0f,
+                  const SpriteTint &tint = WHITE_TINT);
+        // Sorts, uploads and draws everything queued since Begin()
+        void End();
+
+        SpriteBatchStats frame_stats;
+        SpriteBatchStats total_stats;
+        size_t frames;
+        // Whether runs are drawn with glDrawElementsInstanced
+        bool instanced;
+        // Records are streamed through a ring, see StreamBuffer.h
+        StreamBuffer stream;
+
+    private:
+        struct Sprite
+        {
+            ShaderProgram *program;
+            GLuint texture;
+            SpriteLayer layer;
+            size_t order;
+            SpriteInstance instance;
+        };
+
+        // Static per-corner data
+        struct Corner
+        {
+            float x, y;
+            float u, v;
+        };
+
+        static bool DrawsBefore(const Sprite &a, const Sprite &b);
+        size_t RecordCapacity() const;
+        // Points the program's inputs at the buffers, instances from first on
+        void SetupAttributes(ShaderProgram &program, size_t first);
+
+        std::vector<Sprite> sprites;
+        std::vector<SpriteInstance> instances;
+        // What the instance buffer holds now
+        std::vector<SpriteInstance> uploaded;
+        size_t capacity;
+        GLuint corner_buffer;
+        // Where the records the stream holds start
+        size_t instance_offset;
+        QuadGeometry quads;
+};
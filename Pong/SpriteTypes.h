@@ -0,0 +1,29 @@
+#pragma once
+
+// Plain sprite description shared by the GL batch and the software
+// renderer, so neither needs the other's headers
+
+// Draw order, lower layers are drawn first
+enum SpriteLayer
+{
+    LAYER_BACKGROUND = 0,
+    LAYER_FIELD      = 1,
+    LAYER_PADDLES    = 2,
+    LAYER_BALL       = 3
+};
+
+// Part of a texture a sprite shows, v0 at the top of the quad
+struct UvRect
+{
+    float u0, v0, u1, v1;
+};
+
+const UvRect FULL_UV_RECT = { 0.0f, 0.0f, 1.0f, 1.0f };
+
+// Colour the texture is multiplied by
+struct SpriteTint
+{
+    unsigned char r, g, b, a;
+};
+
+const SpriteTint WHITE_TINT = { 255, 255, 255, 255 };
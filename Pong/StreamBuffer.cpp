@@ -0,0 +1,163 @@
+#include "StreamBuffer.h"
+#include "GLStateCache.h"
+#include "GameClock.h"
+#include "Logger.h"
+#include "QuadGeometry.h"
+#include <SDL.h>
+#include <string.h>
+
+// Longest single wait on a fence before checking again, in nanoseconds
+const GLuint64 FENCE_WAIT_NS = 1000000;
+
+static const char* const STRATEGY_NAMES[STREAM_STRATEGIES] = { "persistent", "orphan", "subdata" };
+
+// Loaded at runtime, macOS stops at GL 4.1 and doesn't export it
+static PFNGLBUFFERSTORAGEPROC buffer_storage = NULL;
+
+const char* stream_strategy_name(StreamStrategy strategy)
+{
+    return STRATEGY_NAMES[strategy];
+}
+
+bool gl_has_buffer_storage()
+{
+    if (buffer_storage != NULL) { return true; }
+    if (!gl_version_at_least(4, 4) and !SDL_GL_ExtensionSupported("GL_ARB_buffer_storage")) { return false; }
+    buffer_storage = (PFNGLBUFFERSTORAGEPROC) SDL_GL_GetProcAddress("glBufferStorage");
+    return buffer_storage != NULL;
+}
+
+StreamBuffer::StreamBuffer()
+    : strategy(STREAM_ORPHAN), buffer(0), frame_bytes(0), writes(0), fence_waits(0),
+      fence_wait_seconds(0.0), mapped(NULL), region(0), written(false), reused(false)
+{
+    memset(fences, 0, sizeof(fences));
+}
+
+void StreamBuffer::Initialise(size_t bytes, StreamStrategy requested)
+{
+    frame_bytes = bytes;
+    strategy = requested;
+    writes = 0;
+    fence_waits = 0;
+    fence_wait_seconds = 0.0;
+    if (strategy == STREAM_PERSISTENT and !gl_has_buffer_storage())
+    {
+        LOG_WARN("No ARB_buffer_storage, streaming by orphaning instead");
+        strategy = STREAM_ORPHAN;
+    }
+
+    glGenBuffers(1, &buffer);
+    gl_state().BindArrayBuffer(buffer);
+    if (strategy == STREAM_PERSISTENT)
+    {
+        // Coherent, so writes need no flush before the draw that reads them
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        buffer_storage(GL_ARRAY_BUFFER, STREAM_FRAMES * frame_bytes, NULL, flags);
+        mapped = (unsigned char*) glMapBufferRange(GL_ARRAY_BUFFER, 0, STREAM_FRAMES * frame_bytes, flags);
+        if (mapped == NULL)
+        {
+            LOG_WARN("Persistent map failed, streaming by orphaning instead");
+            gl_state().ForgetBuffer(buffer);
+            glDeleteBuffers(1, &buffer);
+            glGenBuffers(1, &buffer);
+            gl_state().BindArrayBuffer(buffer);
+            strategy = STREAM_ORPHAN;
+        }
+    }
+    if (strategy != STREAM_PERSISTENT)
+    {
+        glBufferData(GL_ARRAY_BUFFER, frame_bytes, NULL, GL_STREAM_DRAW);
+    }
+}
+
+void StreamBuffer::Cleanup()
+{
+    for (int i = 0; i < STREAM_FRAMES; i++)
+    {
+        if (fences[i] != NULL) { glDeleteSync(fences[i]); }
+        fences[i] = NULL;
+    }
+    if (mapped != NULL)
+    {
+        gl_state().BindArrayBuffer(buffer);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+        mapped = NULL;
+    }
+    gl_state().ForgetBuffer(buffer);
+    glDeleteBuffers(1, &buffer);
+    buffer = 0;
+    region = 0;
+    written = false;
+    reused = false;
+}
+
+size_t StreamBuffer::Write(const void *data, size_t bytes)
+{
+    if (bytes > frame_bytes) { bytes = frame_bytes; }
+    gl_state().BindArrayBuffer(buffer);
+    writes++;
+    written = true;
+
+    if (strategy == STREAM_ORPHAN)
+    {
+        // Fresh storage so the driver doesn't wait on last frame's draws
+        glBufferData(GL_ARRAY_BUFFER, frame_bytes, NULL, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+        return 0;
+    }
+    if (strategy == STREAM_SUBDATA)
+    {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, data);
+        return 0;
+    }
+
+    // The region was last written STREAM_FRAMES frames ago; wait for the
+    // GPU to finish reading it if it is that far behind
+    GLsync &fence = fences[region];
+    if (fence != NULL)
+    {
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            uint64_t start = clock_counter();
+            while (result == GL_TIMEOUT_EXPIRED)
+            {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_NS);
+            }
+            fence_waits++;
+            fence_wait_seconds += (double) (clock_counter() - start) / clock_frequency();
+        }
+        glDeleteSync(fence);
+        fence = NULL;
+    }
+    size_t offset = region * frame_bytes;
+    memcpy(mapped + offset, data, bytes);
+    return offset;
+}
+
+void StreamBuffer::Reuse()
+{
+    reused = true;
+}
+
+void StreamBuffer::EndFrame()
+{
+    bool was_written = written, was_reused = reused;
+    written = false;
+    reused = false;
+    if (strategy != STREAM_PERSISTENT) { return; }
+    if (was_written)
+    {
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % STREAM_FRAMES;
+    }
+    else if (was_reused)
+    {
+        // The last region is still read this frame, so the write that comes
+        // back round to it has to wait for these draws, not the upload's
+        int last = (region + STREAM_FRAMES - 1) % STREAM_FRAMES;
+        if (fences[last] != NULL) { glDeleteSync(fences[last]); }
+        fences[last] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+}
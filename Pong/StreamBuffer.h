@@ -0,0 +1,66 @@
+#pragma once
+
+#ifdef _WINDOWS
+	#include <GL/glew.h>
+#endif
+#define GL_GLEXT_PROTOTYPES 1
+#include <SDL_opengl.h>
+#include <stddef.h>
+
+// Frames of data a persistent ring keeps: one being written while the
+// two before it may still be read by the GPU
+const int STREAM_FRAMES = 3;
+
+// How a frame's data reaches the buffer
+enum StreamStrategy
+{
+    // Mapped once with ARB_buffer_storage, written in place, fenced
+    STREAM_PERSISTENT,
+    // glBufferData(NULL) for fresh storage, then glBufferSubData
+    STREAM_ORPHAN,
+    // glBufferSubData over the same storage, the driver sorts out hazards
+    STREAM_SUBDATA,
+    STREAM_STRATEGIES
+};
+
+const char* stream_strategy_name(StreamStrategy strategy);
+// Whether the context can map buffers persistently
+bool gl_has_buffer_storage();
+
+// Array buffer for data rewritten every frame. Write() returns the offset
+// the data landed at; attributes are pointed there before drawing, and
+// EndFrame() marks the frame as submitted. A frame that draws last frame's
+// data again calls Reuse() instead of writing it.
+class StreamBuffer {
+    public:
+        StreamBuffer();
+
+        // Persistent falls back to orphaning where buffer storage is missing
+        void Initialise(size_t frame_bytes, StreamStrategy strategy);
+        void Cleanup();
+
+        // Copies at most frame_bytes into this frame's region and leaves the
+        // buffer bound to GL_ARRAY_BUFFER. One write per frame.
+        size_t Write(const void *data, size_t bytes);
+        // Draws this frame read the region last written
+        void Reuse();
+        // Fences the region written or reused this frame, and after a
+        // write moves on to the next
+        void EndFrame();
+
+        StreamStrategy strategy;
+        GLuint buffer;
+        size_t frame_bytes;
+
+        size_t writes;
+        // Writes that found their region still in use and waited for it
+        size_t fence_waits;
+        double fence_wait_seconds;
+
+    private:
+        unsigned char *mapped;
+        GLsync fences[STREAM_FRAMES];
+        int region;
+        bool written;
+        bool reused;
+};
@@ -0,0 +1,213 @@
+#include "Tracer.h"
+#include <algorithm>
+#include <atomic>
+#include <set>
+#include <stdio.h>
+#include <vector>
+
+// One finished zone. The fields are atomics, relaxed on both sides, so the
+// exporter can copy a slot the owner is overwriting without a data race;
+// it finds out afterwards and throws the copy away.
+struct TraceEvent
+{
+    std::atomic<const char*> name;
+    std::atomic<const char*> detail;
+    std::atomic<uint64_t> start;
+    std::atomic<uint64_t> end;
+    // Buffers move between threads, so each event says whose it is
+    std::atomic<const char*> thread_name;
+    std::atomic<int> thread_id;
+};
+
+// Plain copy of an event taken while writing the trace
+struct TraceEventCopy
+{
+    const char *name;
+    const char *detail;
+    uint64_t start;
+    uint64_t end;
+    const char *thread_name;
+    int thread_id;
+};
+
+// Ring of the newest events of one thread at a time. Only the owner
+// writes. begun counts events whose slot has been claimed, published
+// those finished; event n lives in slot n % TRACE_EVENTS_PER_THREAD.
+struct TraceBuffer
+{
+    TraceEvent events[TRACE_EVENTS_PER_THREAD];
+    std::atomic<uint64_t> begun;
+    std::atomic<uint64_t> published;
+    // Cleared when the owning thread exits, so a new thread can take over
+    // the buffer instead of allocating another
+    std::atomic<bool> in_use;
+    TraceBuffer *next;
+};
+
+// The thread currently writing to a buffer, and its identity
+struct TraceThread
+{
+    TraceBuffer *buffer;
+    const char *name;
+    int id;
+
+    TraceThread() : buffer(NULL), name(NULL), id(0) {}
+    ~TraceThread()
+    {
+        if (buffer != NULL) { buffer->in_use.store(false, std::memory_order_release); }
+    }
+};
+
+// Every buffer ever made, pushed on with a CAS and never removed. There are
+// only as many as threads were ever recording at once.
+static std::atomic<TraceBuffer*> trace_buffers(NULL);
+static std::atomic<int> next_thread_id(1);
+static thread_local TraceThread trace_thread;
+
+// Reference point for turning trace_now() ticks into microseconds
+static const uint64_t trace_epoch = trace_now();
+static const uint64_t counter_epoch = clock_counter();
+
+static TraceThread& register_thread()
+{
+    TraceThread &thread = trace_thread;
+    thread.id = next_thread_id.fetch_add(1);
+    // A buffer left behind by a thread that has finished, oldest events and all
+    for (TraceBuffer *buffer = trace_buffers.load(std::memory_order_acquire); buffer != NULL; buffer = buffer->next)
+    {
+        bool free = false;
+        if (buffer->in_use.compare_exchange_strong(free, true, std::memory_order_acquire))
+        {
+            thread.buffer = buffer;
+            return thread;
+        }
+    }
+    TraceBuffer *buffer = new TraceBuffer();
+    buffer->begun.store(0, std::memory_order_relaxed);
+    buffer->published.store(0, std::memory_order_relaxed);
+    buffer->in_use.store(true, std::memory_order_relaxed);
+    buffer->next = trace_buffers.load(std::memory_order_relaxed);
+    while (!trace_buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release)) {}
+    thread.buffer = buffer;
+    return thread;
+}
+
+void trace_record(const char *name, const char *detail, uint64_t start, uint64_t end)
+{
+    TraceThread &thread = trace_thread.buffer != NULL ? trace_thread : register_thread();
+    TraceBuffer *buffer = thread.buffer;
+    uint64_t index = buffer->begun.load(std::memory_order_relaxed);
+    // Claim the slot before touching it, so a copy that overlaps this can
+    // tell the event it read may be torn
+    buffer->begun.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    TraceEvent &event = buffer->events[index % TRACE_EVENTS_PER_THREAD];
+    event.name.store(name, std::memory_order_relaxed);
+    event.detail.store(detail, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    event.thread_name.store(thread.name, std::memory_order_relaxed);
+    event.thread_id.store(thread.id, std::memory_order_relaxed);
+    buffer->published.store(index + 1, std::memory_order_release);
+}
+
+void trace_set_thread_name(const char *name)
+{
+    TraceThread &thread = trace_thread.buffer != NULL ? trace_thread : register_thread();
+    thread.name = name;
+}
+
+uint64_t trace_dropped()
+{
+    uint64_t dropped = 0;
+    for (TraceBuffer *buffer = trace_buffers.load(std::memory_order_acquire); buffer != NULL; buffer = buffer->next)
+    {
+        uint64_t published = buffer->published.load(std::memory_order_acquire);
+        if (published > TRACE_EVENTS_PER_THREAD) { dropped += published - TRACE_EVENTS_PER_THREAD; }
+    }
+    return dropped;
+}
+
+// Copies out the events of a buffer that are still whole, oldest first
+static void copy_events(const TraceBuffer &buffer, std::vector<TraceEventCopy> &copies)
+{
+    copies.clear();
+    uint64_t published = buffer.published.load(std::memory_order_acquire);
+    uint64_t first = published > TRACE_EVENTS_PER_THREAD ? published - TRACE_EVENTS_PER_THREAD : 0;
+    for (uint64_t n = first; n < published; n++)
+    {
+        const TraceEvent &event = buffer.events[n % TRACE_EVENTS_PER_THREAD];
+        TraceEventCopy copy = {
+            event.name.load(std::memory_order_relaxed), event.detail.load(std::memory_order_relaxed),
+            event.start.load(std::memory_order_relaxed), event.end.load(std::memory_order_relaxed),
+            event.thread_name.load(std::memory_order_relaxed), event.thread_id.load(std::memory_order_relaxed)
+        };
+        copies.push_back(copy);
+    }
+    // Anything the owner started overwriting meanwhile is dropped, it may
+    // be half old and half new
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t begun = buffer.begun.load(std::memory_order_relaxed);
+    uint64_t valid = begun > TRACE_EVENTS_PER_THREAD ? begun - TRACE_EVENTS_PER_THREAD : 0;
+    if (valid > first) { copies.erase(copies.begin(), copies.begin() + (size_t) std::min(valid - first, (uint64_t) copies.size())); }
+}
+
+// Writes a string with quotes and backslashes escaped
+static void write_json_string(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for (; *text != '\0'; text++)
+    {
+        if (*text == '"' or *text == '\\') { fputc('\\', file); }
+        if ((unsigned char) *text >= 0x20) { fputc(*text, file); }
+    }
+    fputc('"', file);
+}
+
+bool trace_write_json(const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL) { return false; }
+
+    // Trace ticks per microsecond, measured over the whole run
+    double microseconds = (double) (clock_counter() - counter_epoch) * 1e6 / clock_frequency();
+    uint64_t ticks = trace_now() - trace_epoch;
+    double ticks_per_us = microseconds > 0.0 and ticks > 0 ? ticks / microseconds : 1.0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    // Names go out once per thread, whichever buffer its events are in
+    std::set<int> named_threads;
+    std::vector<TraceEventCopy> events;
+    for (TraceBuffer *buffer = trace_buffers.load(std::memory_order_acquire); buffer != NULL; buffer = buffer->next)
+    {
+        copy_events(*buffer, events);
+        for (const TraceEventCopy &event : events)
+        {
+            if (event.thread_name != NULL and named_threads.insert(event.thread_id).second)
+            {
+                fprintf(file, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                        first ? "" : ",\n", event.thread_id);
+                write_json_string(file, event.thread_name);
+                fprintf(file, "}}");
+                first = false;
+            }
+            fprintf(file, "%s{\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"name\":", first ? "" : ",\n", event.thread_id);
+            write_json_string(file, event.name);
+            fprintf(file, ",\"ts\":%.3f,\"dur\":%.3f",
+                    (double) (int64_t) (event.start - trace_epoch) / ticks_per_us,
+                    (double) (event.end - event.start) / ticks_per_us);
+            if (event.detail != NULL)
+            {
+                fprintf(file, ",\"args\":{\"detail\":");
+                write_json_string(file, event.detail);
+                fprintf(file, "}");
+            }
+            fprintf(file, "}");
+            first = false;
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "GameClock.h"
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef POKEPONG_X86_DISPATCH
+#include <x86intrin.h>
+#endif
+
+// Zones kept per thread; each buffer is a ring, so a long run keeps its
+// latest zones and the oldest are overwritten and counted
+const size_t TRACE_EVENTS_PER_THREAD = 1 << 16;
+
+// Cheapest monotonic counter on this CPU. The rate is worked out against
+// clock_counter() when the trace is written.
+inline uint64_t trace_now()
+{
+#if defined(POKEPONG_X86_DISPATCH)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    asm volatile("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+#else
+    return clock_counter();
+#endif
+}
+
+// Appends a finished zone to this thread's ring without locking. Buffers of
+// threads that have exited are handed to new threads, not freed.
+// name and detail must outlive the trace, string literals are the norm.
+void trace_record(const char *name, const char *detail, uint64_t start, uint64_t end);
+
+// Shows up as the thread's name in the viewer
+void trace_set_thread_name(const char *name);
+
+// Writes every buffer as Chrome trace_event JSON, for chrome://tracing or
+// Perfetto. Safe to call while other threads keep recording.
+bool trace_write_json(const char *path);
+
+// Zones overwritten by newer ones, so missing from the trace
+uint64_t trace_dropped();
+
+// Records the lifetime of a scope
+class TraceZone {
+    public:
+        explicit TraceZone(const char *name, const char *detail = NULL)
+            : name(name), detail(detail), start(trace_now()) {}
+        ~TraceZone() { trace_record(name, detail, start, trace_now()); }
+
+    private:
+        TraceZone(const TraceZone&);
+        TraceZone& operator=(const TraceZone&);
+
+        const char *name;
+        const char *detail;
+        uint64_t start;
+};
+
+// Zones only exist in builds with POKEPONG_TRACE defined
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef POKEPONG_TRACE
+#define TRACE_ZONE(name) TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#define TRACE_ZONE_DETAIL(name, detail) TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name, detail)
+#else
+#define TRACE_ZONE(name) ((void) 0)
+#define TRACE_ZONE_DETAIL(name, detail) ((void) 0)
+#endif
@@ -0,0 +1,63 @@
+#!/usr/bin/env python3
+"""
+Writes a header that builds assets into the executable, for AssetSource.cpp
+to include when POKEPONG_EMBED_ASSETS is defined.
+
+Usage: embed_assets.py <out.h> <file>...
+
+Paths are kept as given, so run it from the Pong directory:
+    python3 embed_assets.py EmbeddedAssetData.h shaders/*.glsl sprites/*.png
+
+The header is only rewritten when its contents change, so running it on
+every build doesn't force a recompile.
+"""
+
+import os
+import sys
+
+BYTES_PER_LINE = 16
+
+
+def embed(paths):
+    lines = ["// Generated by embed_assets.py, do not edit", "#pragma once", ""]
+    for index, path in enumerate(paths):
+        with open(path, "rb") as source:
+            data = source.read()
+        lines.append("// %s, %d bytes" % (path, len(data)))
+        lines.append("static constexpr unsigned char EMBEDDED_DATA_%d[] = {" % index)
+        for start in range(0, len(data), BYTES_PER_LINE):
+            chunk = data[start:start + BYTES_PER_LINE]
+            lines.append("    " + ", ".join("0x%02x" % byte for byte in chunk) + ",")
+        if not data:
+            lines.append("    0")
+        lines.append("};")
+        lines.append("")
+    lines.append("static constexpr EmbeddedAsset EMBEDDED_ASSETS[] = {")
+    for index, path in enumerate(paths):
+        size = "sizeof(EMBEDDED_DATA_%d)" % index if os.path.getsize(path) > 0 else "0"
+        lines.append('    { "%s", EMBEDDED_DATA_%d, %s },' % (path.replace("\\", "/"), index, size))
+    lines.append("};")
+    lines.append("static constexpr size_t EMBEDDED_ASSET_COUNT = %d;" % len(paths))
+    return "\n".join(lines) + "\n"
+
+
+def main(arguments):
+    if len(arguments) < 2:
+        sys.stderr.write(__doc__)
+        return 1
+    output, paths = arguments[0], arguments[1:]
+    text = embed(paths)
+    if os.path.exists(output):
+        with open(output) as existing:
+            if existing.read() == text:
+                return 0
+    directory = os.path.dirname(output)
+    if directory:
+        os.makedirs(directory, exist_ok=True)
+    with open(output, "w") as header:
+        header.write(text)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
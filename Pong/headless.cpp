@@ -0,0 +1,573 @@
+/**
+* Headless match runner. Advances many independent matches without a window
+* or a GL context, for AI training and regression runs.
+*
+* Usage: PongSim [--soa | --verify] [--dt ms] [matches] [max_steps]
+*        PongSim --bench-collision [bodies] [iterations]
+*        PongSim --events [matches] [seconds]
+*        PongSim --clock-soak [days]
+*        PongSim --bench-log [frames]
+*        PongSim --bench-trace [trace.json]
+*   --soa              step the matches with the SIMD MatchBatch engine
+*   --verify           check MatchBatch against step() lane for lane
+*   --dt               step size in milliseconds, default 16.7
+*   --bench-collision  time collided() against the batch overlap kernels
+*   --events           compare the event-driven mode with ticking step()
+*   --clock-soak       feed GameClock weeks of 60 Hz frames and check the deltas
+*   --bench-log        frame-time spread with a slow log sink, sync vs async
+*   --bench-trace      cost of one trace zone, optionally writing the trace out
+**/
+
+#include "Collision.h"
+#include "GameClock.h"
+#include "Logger.h"
+#include "MatchBatch.h"
+#include "Simulation.h"
+#include "Tracer.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+// Default run size
+const size_t DEFAULT_MATCHES = 4096;
+const int DEFAULT_MAX_STEPS = 20000;
+
+// Fixed step used by the headless runner, --dt overrides it
+const float DEFAULT_DELTA_TIME = 1.0f / 60.0f;
+float sim_delta_time = DEFAULT_DELTA_TIME;
+
+// How a run should be stepped
+enum RunMode { RUN_AOS, RUN_SOA, RUN_VERIFY };
+
+struct RunResult
+{
+    std::vector<MatchState> states;
+    long long total_steps;
+    double seconds;
+};
+
+// Simple AI, moves the paddle towards the ball with a dead zone
+static float track_ball(float pad_y, float ball_y, float dead_zone)
+{
+    if (ball_y > pad_y + dead_zone) { return 1.0f; }
+    if (ball_y < pad_y - dead_zone) { return -1.0f; }
+    return 0.0f;
+}
+
+// Spread the kick-off angle and the AI sloppiness so matches differ
+static void make_matches(size_t match_count, std::vector<glm::vec3> &kick_offs,
+                         std::vector<float> &dead_zones)
+{
+    srand(1234);
+    kick_offs.resize(match_count);
+    dead_zones.resize(match_count);
+    for (size_t i = 0; i < match_count; i++)
+    {
+        float slope = 0.2f + 0.6f * (float) rand() / RAND_MAX;
+        float direction = (i % 2 == 0) ? -1.0f : 1.0f;
+        kick_offs[i] = glm::vec3(direction, -slope, 0.0f);
+        dead_zones[i] = 0.5f + 2.5f * (float) rand() / RAND_MAX;
+    }
+}
+
+// One MatchState per match, stepped with step_batch()
+static RunResult run_aos(const std::vector<glm::vec3> &kick_offs,
+                         const std::vector<float> &dead_zones, int max_steps)
+{
+    size_t match_count = kick_offs.size();
+    RunResult result;
+    result.states.resize(match_count);
+    std::vector<MatchInput> inputs(match_count);
+    for (size_t i = 0; i < match_count; i++) { reset_match(result.states[i], kick_offs[i]); }
+
+    auto start = std::chrono::steady_clock::now();
+    result.total_steps = 0;
+    size_t running = match_count;
+    for (int s = 0; s < max_steps and running > 0; s++)
+    {
+        for (size_t i = 0; i < match_count; i++)
+        {
+            const MatchState &state = result.states[i];
+            float ball_y = (INIT_POSITION_BALL + state.position_ball).y;
+            inputs[i].left_pad = track_ball((INIT_POSITION_LEFT_PAD + state.position_left_pad).y,
+                                            ball_y, dead_zones[i]);
+            inputs[i].right_pad = track_ball((INIT_POSITION_RIGHT_PAD + state.position_right_pad).y,
+                                             ball_y, dead_zones[i]);
+        }
+        result.total_steps += (long long) running;
+        running = step_batch(result.states.data(), inputs.data(), match_count, sim_delta_time);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
+
+// Structure-of-arrays store, stepped with the SIMD kernels
+static RunResult run_soa(const std::vector<glm::vec3> &kick_offs,
+                         const std::vector<float> &dead_zones, int max_steps)
+{
+    size_t match_count = kick_offs.size();
+    MatchBatch batch(match_count);
+    std::vector<float> left_inputs(batch.padded_count, 0.0f);
+    std::vector<float> right_inputs(batch.padded_count, 0.0f);
+    for (size_t i = 0; i < match_count; i++) { batch.Reset(i, kick_offs[i]); }
+
+    RunResult result;
+    auto start = std::chrono::steady_clock::now();
+    result.total_steps = 0;
+    size_t running = match_count;
+    for (int s = 0; s < max_steps and running > 0; s++)
+    {
+        for (size_t i = 0; i < match_count; i++)
+        {
+            float ball_y = INIT_POSITION_BALL.y + batch.position_ball_y[i];
+            left_inputs[i] = track_ball(INIT_POSITION_LEFT_PAD.y + batch.position_left_pad_y[i],
+                                        ball_y, dead_zones[i]);
+            right_inputs[i] = track_ball(INIT_POSITION_RIGHT_PAD.y + batch.position_right_pad_y[i],
+                                         ball_y, dead_zones[i]);
+        }
+        result.total_steps += (long long) running;
+        running = batch.Step(left_inputs.data(), right_inputs.data(), sim_delta_time);
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.states.resize(match_count);
+    for (size_t i = 0; i < match_count; i++) { batch.Store(i, result.states[i]); }
+    return result;
+}
+
+static void print_result(const char* name, const RunResult &result)
+{
+    long long hits = 0;
+    size_t finished = 0;
+    int wins[3] = { 0, 0, 0 };
+    for (const MatchState &state : result.states)
+    {
+        hits += state.paddle_hits;
+        wins[state.winner]++;
+        if (state.end_game) { finished++; }
+    }
+    double seconds = result.seconds;
+    std::cout << "engine:         " << name << '\n'
+              << "matches:        " << result.states.size() << '\n'
+              << "finished:       " << finished << '\n'
+              << "p1/p2 wins:     " << wins[1] << '/' << wins[2] << '\n'
+              << "paddle hits:    " << hits << '\n'
+              << "match steps:    " << result.total_steps << '\n'
+              << "wall time (s):  " << seconds << '\n'
+              << "steps/sec:      " << (seconds > 0.0 ? result.total_steps / seconds : 0.0) << '\n'
+              << "sim sec/sec:    " << (seconds > 0.0 ? result.total_steps * sim_delta_time / seconds : 0.0) << '\n';
+}
+
+// Number of matches whose final state differs between the two engines
+static size_t count_mismatches(const RunResult &a, const RunResult &b)
+{
+    size_t mismatches = 0;
+    for (size_t i = 0; i < a.states.size(); i++)
+    {
+        const MatchState &x = a.states[i];
+        const MatchState &y = b.states[i];
+        if (x.end_game != y.end_game or x.winner != y.winner or
+            x.paddle_hits != y.paddle_hits or
+            x.position_ball.x != y.position_ball.x or x.position_ball.y != y.position_ball.y or
+            x.movement_ball.x != y.movement_ball.x or x.movement_ball.y != y.movement_ball.y or
+            x.position_left_pad.y != y.position_left_pad.y or x.position_right_pad.y != y.position_right_pad.y or
+            x.rot_angle != y.rot_angle)
+        {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+// Random boxes around the ball, sized like balls and paddles
+static double bench_collision(size_t body_count, int iterations)
+{
+    std::vector<glm::vec3> positions(body_count), sizes(body_count);
+    std::vector<float> center_x(body_count), center_y(body_count), half_x(body_count), half_y(body_count);
+    srand(99);
+    for (size_t i = 0; i < body_count; i++)
+    {
+        positions[i] = glm::vec3(10.0f * rand() / RAND_MAX - 5.0f, 7.5f * rand() / RAND_MAX - 3.75f, 0.0f);
+        sizes[i] = (i % 4 == 0) ? SIZE_PADDLE : SIZE_BALL;
+        center_x[i] = positions[i].x;
+        center_y[i] = positions[i].y;
+        half_x[i] = 0.5f * sizes[i].x;
+        half_y[i] = 0.5f * sizes[i].y;
+    }
+    AabbArrays bodies = { center_x.data(), center_y.data(), half_x.data(), half_y.data(), body_count };
+    std::vector<uint32_t> mask(overlap_mask_words(body_count));
+    glm::vec3 zero = glm::vec3(0.0f, 0.0f, 0.0f);
+    double tests = (double) body_count * iterations;
+
+    // Existing one-against-one function
+    long long reference_hits = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int it = 0; it < iterations; it++)
+    {
+        glm::vec3 ball = glm::vec3(0.001f * (it % 100), 0.0f, 0.0f);
+        for (size_t i = 0; i < body_count; i++)
+        {
+            if (collided(ball, positions[i], INIT_POSITION_BALL, zero, SIZE_BALL, sizes[i]))
+            { reference_hits++; }
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << std::left << std::setw(13) << "collided()" << seconds * 1e9 / tests << " ns/test, hits " << reference_hits << '\n';
+
+    // Batch kernels, capped at what this CPU supports
+    SimdLevel best = detect_simd_level();
+    for (int level = SIMD_SCALAR; level <= best; level++)
+    {
+        long long hits = 0;
+        start = std::chrono::steady_clock::now();
+        for (int it = 0; it < iterations; it++)
+        {
+            float ball_x = INIT_POSITION_BALL.x + 0.001f * (it % 100);
+            overlap_one_vs_many_with((SimdLevel) level, ball_x, INIT_POSITION_BALL.y,
+                                     0.5f * SIZE_BALL.x, 0.5f * SIZE_BALL.y, bodies, mask.data());
+            for (uint32_t word : mask) { hits += __builtin_popcount(word); }
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << std::setw(13) << simd_level_name((SimdLevel) level) << seconds * 1e9 / tests << " ns/test, hits " << hits
+                  << (hits == reference_hits ? "" : "  MISMATCH") << '\n';
+        if (hits != reference_hits) { return -1.0; }
+    }
+    return seconds;
+}
+
+// Tick used as the reference when checking the event-driven mode
+const float EVENTS_REFERENCE_TICK = 1.0f / 240.0f;
+// Goal times may differ by a tick plus paddle-stop rounding
+const double EVENTS_TIME_TOLERANCE = 0.05;
+
+// Random paddle input changes, on the tick grid so both modes see the same input
+static std::vector<InputChange> make_schedule(double duration, float tick)
+{
+    std::vector<InputChange> changes;
+    long long ticks = 0;
+    while (ticks * (double) tick < duration)
+    {
+        InputChange change;
+        change.time = ticks * (double) tick;
+        change.input.left_pad = (float) (rand() % 3 - 1);
+        change.input.right_pad = (float) (rand() % 3 - 1);
+        changes.push_back(change);
+        ticks += 20 + rand() % 200;
+    }
+    return changes;
+}
+
+// Runs each match both ways and counts the ones whose outcome agrees
+static bool compare_events(size_t match_count, double duration)
+{
+    std::vector<glm::vec3> kick_offs;
+    std::vector<float> dead_zones;
+    make_matches(match_count, kick_offs, dead_zones);
+
+    size_t agreed = 0, goals = 0;
+    long long ticks = 0, events = 0;
+    double tick_seconds = 0.0, event_seconds = 0.0;
+    for (size_t i = 0; i < match_count; i++)
+    {
+        std::vector<InputChange> changes = make_schedule(duration, EVENTS_REFERENCE_TICK);
+
+        // Reference, one step() per tick
+        MatchState ticked;
+        reset_match(ticked, kick_offs[i]);
+        auto start = std::chrono::steady_clock::now();
+        size_t next_change = 0;
+        MatchInput input = { 0.0f, 0.0f };
+        int tick = 0;
+        for (; !ticked.end_game and tick * (double) EVENTS_REFERENCE_TICK < duration; tick++)
+        {
+            while (next_change < changes.size() and
+                   changes[next_change].time <= tick * (double) EVENTS_REFERENCE_TICK)
+            {
+                input = changes[next_change++].input;
+            }
+            step(ticked, input, EVENTS_REFERENCE_TICK);
+        }
+        tick_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        ticks += tick;
+
+        // Event-driven
+        MatchState jumped;
+        reset_match(jumped, kick_offs[i]);
+        double time = 0.0;
+        start = std::chrono::steady_clock::now();
+        events += simulate_events(jumped, time, changes.data(), changes.size(), duration);
+        event_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double ticked_time = tick * (double) EVENTS_REFERENCE_TICK;
+        bool same = ticked.end_game == jumped.end_game and ticked.winner == jumped.winner and
+                    (!jumped.end_game or fabs(ticked_time - time) <= EVENTS_TIME_TOLERANCE);
+        if (same) { agreed++; }
+        if (jumped.end_game) { goals++; }
+    }
+
+    std::cout << "matches:        " << match_count << '\n'
+              << "goals:          " << goals << '\n'
+              << "agreed:         " << agreed << '\n'
+              << "ticks:          " << ticks << " in " << tick_seconds << " s\n"
+              << "events:         " << events << " in " << event_seconds << " s\n";
+    // Paddle-stop rounding can flip the odd edge-of-paddle contact
+    return agreed * 100 >= match_count * 99;
+}
+
+// Counter rates seen in the wild: clock_gettime, Apple silicon, Windows QPC
+const uint64_t SOAK_FREQUENCIES[] = { 1000000000ull, 24000000ull, 10000000ull };
+const int SOAK_FRAME_RATE = 60;
+
+// Runs a GameClock through days of 60 Hz frames, starting just before the
+// counter wraps, and checks every delta against the exact frame length.
+// The old float-seconds clock is run alongside for comparison.
+static bool clock_soak(double days)
+{
+    long long frames = (long long) (days * 86400.0 * SOAK_FRAME_RATE);
+    double frame = 1.0 / SOAK_FRAME_RATE;
+    bool passed = true;
+    for (uint64_t frequency : SOAK_FREQUENCIES)
+    {
+        uint64_t base = UINT64_MAX - 10 * frequency;
+        GameClock clock, half_speed;
+        clock.Start(base, frequency);
+        half_speed.Start(base, frequency);
+        half_speed.SetTimeScale(0.5);
+
+        double max_error = 0.0, max_float_error = 0.0;
+        uint64_t previous = base;
+        float previous_seconds = 0.0f;
+        for (long long n = 1; n <= frames; n++)
+        {
+            uint64_t counter = base + (uint64_t) n * frequency / SOAK_FRAME_RATE;
+            double delta = clock.Advance(counter);
+            half_speed.Advance(counter);
+            double error = fabs(delta - (double) (counter - previous) / frequency);
+            if (error > max_error) { max_error = error; }
+            previous = counter;
+
+            // What update() used to do with SDL_GetTicks()
+            float seconds = (float) ((uint64_t) n * 1000 / SOAK_FRAME_RATE) / 1000.0f;
+            float float_error = fabsf((seconds - previous_seconds) - (float) frame);
+            if (float_error > max_float_error) { max_float_error = float_error; }
+            previous_seconds = seconds;
+        }
+
+        // Half speed may trail by the carried fraction of a tick
+        double game_error = fabs(half_speed.GameSeconds() - 0.5 * clock.GameSeconds());
+        bool ok = max_error <= 1e-12 and game_error <= 1.0 / frequency and
+                  fabs(clock.RealSeconds() - frames * frame) <= 1.0 / frequency;
+        std::cout << "frequency " << frequency << " Hz: max delta error " << max_error
+                  << " s, float clock " << max_float_error << " s, half speed drift " << game_error
+                  << " s" << (ok ? "" : "  FAILED") << '\n';
+        if (!ok) { passed = false; }
+    }
+
+    // Pausing stops game time but not real time
+    GameClock clock;
+    clock.Start(0, 1000);
+    clock.SetPaused(true);
+    double paused_delta = clock.Advance(500);
+    clock.SetPaused(false);
+    double resumed_delta = clock.Advance(516);
+    bool pause_ok = paused_delta == 0.0 and resumed_delta == 0.016 and clock.RealSeconds() == 0.516;
+    bool wrap_ok = wrap_degrees(-30.0) == 330.0 and wrap_degrees(725.0) == 5.0;
+    std::cout << "frames:         " << frames << " per clock (" << days << " days)\n"
+              << "pause:          " << (pause_ok ? "ok" : "FAILED") << '\n'
+              << "angle wrap:     " << (wrap_ok ? "ok" : "FAILED") << '\n';
+    return passed and pause_ok and wrap_ok;
+}
+
+// Work done by one fake frame, and how a slow stdout pipe behaves: every
+// write costs a little and every so often the pipe is full and blocks
+const double BENCH_FRAME_WORK_US = 500.0;
+const int SLOW_SINK_WRITE_US = 50;
+const int SLOW_SINK_STALL_US = 4000;
+const int SLOW_SINK_STALL_EVERY = 32;
+
+static void slow_sink(LogLevel, const char*, size_t)
+{
+    static int writes = 0;
+    bool stall = ++writes % SLOW_SINK_STALL_EVERY == 0;
+    std::this_thread::sleep_for(std::chrono::microseconds(stall ? SLOW_SINK_STALL_US : SLOW_SINK_WRITE_US));
+}
+
+static void null_sink(LogLevel, const char*, size_t) {}
+
+// Ways of logging one line per frame
+enum LogBenchMode { LOG_BENCH_OFF, LOG_BENCH_SYNC_SLOW, LOG_BENCH_ASYNC_SLOW, LOG_BENCH_ASYNC_NULL };
+
+// Frame times in microseconds, sorted
+static std::vector<double> log_bench_frames(LogBenchMode mode, int frames)
+{
+    if (mode == LOG_BENCH_ASYNC_SLOW) { log_start(slow_sink); }
+    if (mode == LOG_BENCH_ASYNC_NULL) { log_start(null_sink); }
+
+    std::vector<double> times(frames);
+    for (int f = 0; f < frames; f++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        while (std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() < BENCH_FRAME_WORK_US) {}
+
+        // What the main loop used to do every frame
+        if (mode == LOG_BENCH_SYNC_SLOW)
+        {
+            LogLine line;
+            line << "end_game " << false;
+            slow_sink(LOG_LEVEL_INFO, line.text, line.length);
+        }
+        else if (mode != LOG_BENCH_OFF) { LOG_INFO("end_game " << false); }
+
+        times[f] = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+    log_stop();
+    std::sort(times.begin(), times.end());
+    return times;
+}
+
+// Frame-time spread with no log, a synchronous slow sink, and the ring
+// in front of a slow and a free sink
+static bool bench_log(int frames)
+{
+    const char* names[] = { "no log", "sync slow", "async slow", "async null" };
+    double p99[4];
+    uint64_t dropped = log_dropped();
+    for (int mode = LOG_BENCH_OFF; mode <= LOG_BENCH_ASYNC_NULL; mode++)
+    {
+        std::vector<double> times = log_bench_frames((LogBenchMode) mode, frames);
+        double sum = 0.0, squares = 0.0;
+        for (double t : times) { sum += t; squares += t * t; }
+        double mean = sum / frames;
+        double deviation = sqrt(fmax(0.0, squares / frames - mean * mean));
+        p99[mode] = times[(size_t) (0.99 * (frames - 1))];
+        std::cout << std::left << std::setw(12) << names[mode] << std::fixed << std::setprecision(1)
+                  << "mean " << mean << " us  stddev " << deviation << " us  p99 " << p99[mode]
+                  << " us  max " << times.back() << " us\n";
+    }
+    std::cout << "dropped lines:  " << log_dropped() - dropped << '\n';
+    // The ring should hide the sink, within a frame's worth of noise
+    return p99[LOG_BENCH_ASYNC_SLOW] < p99[LOG_BENCH_SYNC_SLOW] and
+           p99[LOG_BENCH_ASYNC_SLOW] < p99[LOG_BENCH_ASYNC_NULL] + BENCH_FRAME_WORK_US;
+}
+
+// Zones timed per round, each round on a fresh thread so its buffer is empty
+const int TRACE_BENCH_ZONES = 60000;
+const int TRACE_BENCH_ROUNDS = 5;
+
+// Best-of-rounds cost of an empty TraceZone and of the counter it reads
+static void bench_trace(const char *path)
+{
+    double best_zone = 1e9, best_now = 1e9;
+    for (int round = 0; round < TRACE_BENCH_ROUNDS; round++)
+    {
+        std::thread worker([&]() {
+            // Registers the buffer outside the timed loop
+            trace_set_thread_name("bench");
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < TRACE_BENCH_ZONES; i++) { TraceZone zone("zone"); }
+            double zone = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            volatile uint64_t sink = 0;
+            start = std::chrono::steady_clock::now();
+            for (int i = 0; i < TRACE_BENCH_ZONES; i++) { sink = sink + trace_now(); }
+            double now = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            if (zone / TRACE_BENCH_ZONES < best_zone) { best_zone = zone / TRACE_BENCH_ZONES; }
+            if (now / TRACE_BENCH_ZONES < best_now) { best_now = now / TRACE_BENCH_ZONES; }
+        });
+        worker.join();
+    }
+    std::cout << "trace_now():    " << best_now << " ns\n"
+              << "zone:           " << best_zone << " ns (two counter reads and a store)\n"
+              << "overwritten:    " << trace_dropped() << '\n';
+
+    if (path != NULL)
+    {
+        // A few nested zones on the main thread, to look at in Perfetto
+        trace_set_thread_name("main");
+        for (int frame = 0; frame < 3; frame++)
+        {
+            TraceZone frame_zone("frame");
+            TraceZone step_zone("step", "8 matches");
+            MatchState state;
+            reset_match(state);
+            for (int i = 0; i < 8; i++) { step(state, MatchInput { 1.0f, -1.0f }, DEFAULT_DELTA_TIME); }
+        }
+        std::cout << "trace:          " << (trace_write_json(path) ? path : "not written") << '\n';
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 and strcmp(argv[1], "--bench-trace") == 0)
+    {
+        bench_trace(argc > 2 ? argv[2] : NULL);
+        return 0;
+    }
+
+    if (argc > 1 and strcmp(argv[1], "--bench-log") == 0)
+    {
+        int frames = argc > 2 ? atoi(argv[2]) : 2000;
+        return bench_log(frames) ? 0 : 1;
+    }
+
+    if (argc > 1 and strcmp(argv[1], "--clock-soak") == 0)
+    {
+        double days = argc > 2 ? atof(argv[2]) : 14.0;
+        return clock_soak(days) ? 0 : 1;
+    }
+
+    if (argc > 1 and strcmp(argv[1], "--events") == 0)
+    {
+        size_t match_count = argc > 2 ? (size_t) atol(argv[2]) : 1000;
+        double duration = argc > 3 ? atof(argv[3]) : 60.0;
+        return compare_events(match_count, duration) ? 0 : 1;
+    }
+
+    if (argc > 1 and strcmp(argv[1], "--bench-collision") == 0)
+    {
+        size_t body_count = argc > 2 ? (size_t) atol(argv[2]) : 4096;
+        int iterations = argc > 3 ? atoi(argv[3]) : 2000;
+        return bench_collision(body_count, iterations) < 0.0 ? 1 : 0;
+    }
+
+    RunMode mode = RUN_AOS;
+    int arg = 1;
+    for (; arg < argc and strncmp(argv[arg], "--", 2) == 0; arg++)
+    {
+        if (strcmp(argv[arg], "--soa") == 0) { mode = RUN_SOA; }
+        else if (strcmp(argv[arg], "--verify") == 0) { mode = RUN_VERIFY; }
+        else if (strcmp(argv[arg], "--dt") == 0 and arg + 1 < argc) { sim_delta_time = (float) atof(argv[++arg]) / 1000.0f; }
+    }
+
+    size_t match_count = arg < argc ? (size_t) atol(argv[arg]) : DEFAULT_MATCHES;
+    int max_steps = arg + 1 < argc ? atoi(argv[arg + 1]) : DEFAULT_MAX_STEPS;
+
+    std::vector<glm::vec3> kick_offs;
+    std::vector<float> dead_zones;
+    make_matches(match_count, kick_offs, dead_zones);
+
+    if (mode == RUN_AOS)
+    {
+        print_result("aos", run_aos(kick_offs, dead_zones, max_steps));
+        return 0;
+    }
+
+    RunResult soa = run_soa(kick_offs, dead_zones, max_steps);
+    print_result(simd_level_name(detect_simd_level()), soa);
+    if (mode == RUN_VERIFY)
+    {
+        RunResult aos = run_aos(kick_offs, dead_zones, max_steps);
+        print_result("aos", aos);
+        size_t mismatches = count_mismatches(aos, soa);
+        std::cout << "mismatches:     " << mismatches << '\n';
+        return mismatches == 0 ? 0 : 1;
+    }
+    return 0;
+}
@@ -10,7 +10,6 @@
 
 #define GL_SILENCE_DEPRECATION
 #define GL_GLEXT_PROTOTYPES 1
-#define LOG(argument) std::cout << argument << '\n'
 #define STB_IMAGE_IMPLEMENTATION
 
 #ifdef _WINDOWS
@@ -21,9 +20,26 @@
 #include <SDL_opengl.h>
 #include "glm/mat4x4.hpp"
 #include "glm/gtc/matrix_transform.hpp"
+#include "AssetLoader.h"
+#include "AssetPack.h"
+#include "AssetSource.h"
+#include "AtlasPacker.h"
+#include "FrameCapture.h"
+#include "FramePacer.h"
+#include "FrameStats.h"
+#include "GLStateCache.h"
+#include "GameClock.h"
+#include "Logger.h"
+#include "ShaderCache.h"
 #include "ShaderProgram.h"
+#include "Simulation.h"
+#include "SoftwareRenderer.h"
+#include "SpriteBatch.h"
+#include "Tracer.h"
 #include "stb_image.h"
+#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 
 // Window dimensions
@@ -62,285 +78,478 @@ const char  SPRITE_LEFT_PADDLE[] = "sprites/left_paddle.png",
             SPRITE_P1_WIN[] = "sprites/p1_win.png",
             SPRITE_P2_WIN[] = "sprites/p2_win.png";
 
+// Slots in the sprite atlas
+enum SpriteId
+{
+    SPRITE_ID_LEFT_PADDLE,
+    SPRITE_ID_RIGHT_PADDLE,
+    SPRITE_ID_BALL,
+    SPRITE_ID_LINE,
+    SPRITE_ID_P1,
+    SPRITE_ID_P2,
+    NUMBER_OF_SPRITES
+};
+
+const char* const SPRITE_PATHS[NUMBER_OF_SPRITES] = {
+    SPRITE_LEFT_PADDLE, SPRITE_RIGHT_PADDLE,
+    SPRITE_BALL, SPRITE_LINE,
+    SPRITE_P1, SPRITE_P2
+};
+
+// Win screens are shown at most once a match, so they stay on disk until
+// one is needed and get their own texture then
+enum WinScreen
+{
+    WIN_SCREEN_P1,
+    WIN_SCREEN_P2,
+    NUMBER_OF_WIN_SCREENS
+};
+
+const char* const WIN_SCREEN_PATHS[NUMBER_OF_WIN_SCREENS] = { SPRITE_P1_WIN, SPRITE_P2_WIN };
+
+// Decode starts once the ball heads for a goal this close to it
+const float WIN_PREFETCH_DISTANCE = 2.0f;
 
-// Define objects
-ShaderProgram   program_left_pad, program_right_pad,
+
+// Define objects, all sharing the program the cache compiled once
+ShaderCache shader_cache;
+std::shared_ptr<ShaderProgram>  program_left_pad, program_right_pad,
                 program_ball, program_line,
                 program_p1, program_p2,
                 program_p1_win, program_p2_win;
 
-// Texture IDs
-GLuint  texture_id_left_pad, texture_id_right_pad,
-        texture_id_ball, texture_id_line,
-        texture_id_p1, texture_id_p2,
-        texture_id_p1_win, texture_id_p2_win;
+// Sprites decode on worker threads while the window and context come up
+AssetLoader asset_loader;
+
+// Cooked by AssetCooker and mapped, so nothing is decoded. Entries older
+// than their PNGs are ignored and the PNGs decoded instead. Builds with the
+// assets embedded decode those and leave the pack alone, so startup reads
+// no files unless POKEPONG_ASSET_DIR points somewhere.
+const char ASSET_PACK_PATH[] = "sprites/sprites.pack",
+           ATLAS_PACK_NAME[] = "sprites";
+AssetPack asset_pack;
+const AssetPackEntry* atlas_pack_entry = NULL;
+
+// Every sprite lives in one texture, each with its own UV rect. The pixels
+// are in the pack mapping or in atlas_layout.
+AtlasLayout atlas_layout;
+const unsigned char* atlas_pixels = NULL;
+int atlas_width, atlas_height;
+GLuint texture_id_atlas;
+int software_texture_atlas;
+UvRect sprite_uvs[NUMBER_OF_SPRITES];
+
+// Win screens, resident once drawn
+LazyImage win_images[NUMBER_OF_WIN_SCREENS];
+const AssetPackEntry* win_pack_entries[NUMBER_OF_WIN_SCREENS];
+bool win_resident[NUMBER_OF_WIN_SCREENS],
+     win_failed[NUMBER_OF_WIN_SCREENS];
+GLuint win_textures[NUMBER_OF_WIN_SCREENS];
+int win_software_textures[NUMBER_OF_WIN_SCREENS];
 
 // Matrices
 glm::mat4 g_view_matrix,            // Camera position
           g_projection_matrix;      // Camera characteristics
 
-// Model matrices
-glm::mat4   model_matrix_left_pad, model_matrix_right_pad,
-            model_matrix_ball, model_matrix_line,
-            model_matrix_p1, model_matrix_p2,
-            model_matrix_p1_win, model_matrix_p2_win;
-
-// Initial positions
-const glm::vec3 INIT_POSITION_LEFT_PAD (-3.5f, 0.0f, 0.0f),
-                INIT_POSITION_RIGHT_PAD (3.5f, 0.0f, 0.0f),
-                INIT_POSITION_BALL (0.0f, 0.0f, 0.0f),
-                INIT_POSITION_LINE (0.0f, 0.0f, 0.0f),
+// Initial positions (paddles and ball live in Simulation.h)
+const glm::vec3 INIT_POSITION_LINE (0.0f, 0.0f, 0.0f),
                 INIT_POSITION_P1 (-2.5f, 3.0f, 0.0f),
                 INIT_POSITION_P2 (2.5f, 3.0f, 0.0f),
                 INIT_POSITION_P1_WIN (0.0f, 0.0f, 0.0f),
                 INIT_POSITION_P2_WIN (0.0f, 0.0f, 0.0f);
 
 // Sizes
-const glm::vec3 SIZE_PADDLE = glm::vec3(1.75f, 3.5f, 1.0f),
-                SIZE_BALL = glm::vec3(0.5f, 0.5f, 0.5f),
-                SIZE_LINE = glm::vec3(1.0f, 1.0f, 1.0f),
+const glm::vec3 SIZE_LINE = glm::vec3(0.1f, 7.5f, 1.0f),
                 SIZE_PLAYER = glm::vec3(2.0f, 1.0f, 1.0f),
                 SIZE_WIN = glm::vec3(3.0f, 3.0f, 1.0f);
 
-// Whether object is moving
+// Whether paddle is moving
 glm::vec3   movement_left_pad,
             movement_right_pad = glm::vec3(0.0f, 0.0f, 0.0f);
-// Ball is initialized to move to the left corner
-glm::vec3   movement_ball = glm::vec3(-1.0f, -0.5f, 0.0f);
 
-// How much object has moved
-glm::vec3   position_left_pad,
-            position_right_pad,
-            position_ball = glm::vec3(0.0f, 0.0f, 0.0f);
+// Ball and paddle state, one fixed step apart so render() can blend them
+MatchState match, previous_match;
+
+// Fixed simulation rate, can be changed with --tick-rate
+const float DEFAULT_TICK_RATE = 120.0f;
+
+float fixed_delta_time = 1.0f / DEFAULT_TICK_RATE;
+double accumulator = 0.0;
+
+// Frame timing, also caps a hitch at MAX_CLOCK_DELTA so it doesn't snowball
+GameClock game_clock;
 
-// Speed
-const float SPEED_PAD = 4.0f,
-            SPEED_BALL = 3.5f,
-            ROT_SPEED_BALL = 45.f;
+// Frame rate cap, can be changed with --fps
+double target_fps = DEFAULT_TARGET_FPS;
+FramePacer frame_pacer;
 
-float rot_angle = 0.0f;
+// Per-phase frame timings, printed on F1 and on exit
+const char DEFAULT_STATS_PATH[] = "frame_stats.json";
+const char* stats_path = DEFAULT_STATS_PATH;
+FrameStats frame_stats;
 
-// Ticks
-float previous_ticks = 0.0f;
+// Chrome trace of the zones, in builds with POKEPONG_TRACE
+const char DEFAULT_TRACE_PATH[] = "pokepong_trace.json";
+const char* trace_path = DEFAULT_TRACE_PATH;
+
+// Every sprite of a frame goes through one streaming vertex buffer
+SpriteBatch sprite_batch;
 
 // Game const
 SDL_Window* display_window;
+// --legacy-gl skips the core context and uses the 2.1 one the game began on
+const int CORE_GL_MAJOR = 3,
+          CORE_GL_MINOR = 3;
+bool legacy_gl = false;
+
+// Linked programs are saved here and restored on later launches. Empty
+// means SDL's per-user preference directory; --shader-cache picks another
+// and --no-shader-cache compiles every time.
+const char* shader_cache_directory = NULL;
+bool use_shader_cache = true;
+
+// --bench-stream [frames] times each StreamStrategy instead of playing
+const int DEFAULT_STREAM_BENCH_FRAMES = 600;
+const size_t STREAM_BENCH_SPRITES = 10000;
+// Tiny so rasterising them doesn't drown out the upload
+const glm::vec3 STREAM_BENCH_SIZE (0.02f, 0.02f, 1.0f);
+int stream_bench_frames = 0;
+// --stream picks how the sprite batch uploads its records
+StreamStrategy stream_strategy = STREAM_PERSISTENT;
+
+// --software draws on the CPU and presents through the window surface,
+// for hosts without a usable GL driver
+bool software_rendering = false;
+SoftwareRenderer software_renderer;
+// --screenshot writes the last frame here as PPM on exit
+const char* screenshot_path = NULL;
+
+// --capture records every frame, to a .y4m video or numbered PNGs
+const int DEFAULT_CAPTURE_FPS = 60;
+const char* capture_path = NULL;
+FrameCapture frame_capture;
 bool game_is_running = true;
 bool end_game = false;
 int winner;
 
-// LOAD TEXTURE
-GLuint load_texture(const char* filepath)
+// CREATE TEXTURE
+GLuint create_texture(const unsigned char* pixels, int width, int height)
 {
-    // STEP 1: Loading the image file
-    int width, height, number_of_components;
-    unsigned char* image = stbi_load(filepath, &width, &height, &number_of_components, STBI_rgb_alpha);
-    
-    if (image == NULL)
-    {
-        LOG("Unable to load image. Make sure the path is correct.");
-        assert(false);
-    }
-    
-    // STEP 2: Generating and binding a texture ID to our image
     GLuint textureID;
     glGenTextures(NUMBER_OF_TEXTURES, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, width, height, TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, image);
+    gl_state().BindTexture(textureID);
+    glTexImage2D(GL_TEXTURE_2D, LEVEL_OF_DETAIL, GL_RGBA, width, height, TEXTURE_BORDER, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
     
-    // STEP 3: Setting our texture filter parameters
+    // Setting our texture filter parameters
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
     
-    // STEP 4: Releasing our file from memory and returning our texture id
-    stbi_image_free(image);
-    
     return textureID;
 }
 
-// DRAW_OBJECT
-void draw_object(ShaderProgram &program, glm::mat4 &model_matrix,
-                 GLuint &texture_id, float* vertices,
-                 float* texture_coordinates)
+// FIND PACK ENTRY
+// A pack entry cooked from exactly these sources and no older than them
+const AssetPackEntry* find_pack_entry(const char* name, AssetPackKind kind,
+                                      const char* const* sources, int source_count)
 {
-    // Vertices
-    glVertexAttribPointer(program.positionAttribute, 2, GL_FLOAT, false, 0, vertices);
-    glEnableVertexAttribArray(program.positionAttribute);
-
-    glVertexAttribPointer(program.texCoordAttribute, 2, GL_FLOAT, false, 0, texture_coordinates);
-    glEnableVertexAttribArray(program.texCoordAttribute);
-    
-    // Bind texture
-    program.SetModelMatrix(model_matrix);
-    glBindTexture(GL_TEXTURE_2D, texture_id);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    
-    // Disable attribute arrays
-    glDisableVertexAttribArray(program.positionAttribute);
-    glDisableVertexAttribArray(program.texCoordAttribute);
-
+    const AssetPackEntry* entry = asset_pack.Find(name);
+    if (entry == NULL or entry->kind != (uint32_t) kind or entry->source_count != (uint32_t) source_count)
+    {
+        return NULL;
+    }
+    for (int i = 0; i < source_count; i++)
+    {
+        if (strcmp(asset_pack.Sources(*entry)[i].path, sources[i]) != 0) { return NULL; }
+    }
+    if (!asset_pack.IsFresh(*entry, asset_directory()))
+    {
+        LOG_INFO("Asset pack entry " << name << " is older than its sources");
+        return NULL;
+    }
+    return entry;
 }
 
-// INITIALISE OBJECTS
-void init_objects(ShaderProgram &program, GLuint &texture_id,
-                  const char* sprite, glm::mat4 &model_matrix,
-                  glm::mat4 &view_matrix, glm::mat4 &projection_matrix,
-                  const glm::vec3 init_position, glm::vec3 size_vector)
+// START ASSET LOADING
+void start_asset_loading()
 {
-    // Load up shaders
-    program.Load(V_SHADER_PATH, F_SHADER_PATH);
-    
-    // Initialize model matrix
-    model_matrix = glm::mat4(1.0f);
-    // Translate to initial position
-    model_matrix  = glm::translate(model_matrix, init_position);
-    // Scale to initial size
-    model_matrix  = glm::scale(model_matrix, size_vector);
-    
-    // Load texture
-    texture_id = load_texture(sprite);
+    if (assets_embedded()) { LOG_INFO("Assets embedded in the executable"); }
+    else if (!asset_directory().empty()) { LOG_INFO("Assets read from " << asset_directory()); }
 
-    // Set matrices
-    program.SetProjectionMatrix(projection_matrix);
-    program.SetViewMatrix(view_matrix);
+    if (!assets_embedded() and asset_pack.Open(asset_path(ASSET_PACK_PATH).c_str()))
+    {
+        atlas_pack_entry = find_pack_entry(ATLAS_PACK_NAME, ASSET_PACK_ATLAS, SPRITE_PATHS, NUMBER_OF_SPRITES);
+        for (int i = 0; i < NUMBER_OF_WIN_SCREENS; i++)
+        {
+            win_pack_entries[i] = find_pack_entry(WIN_SCREEN_PATHS[i], ASSET_PACK_IMAGE, &WIN_SCREEN_PATHS[i], 1);
+        }
+    }
+    else if (!assets_embedded())
+    {
+        LOG_INFO("No usable asset pack at " << asset_path(ASSET_PACK_PATH) << ", decoding the PNGs");
+    }
 
-    // Object ID
-    glUseProgram(program.programID);
+    if (atlas_pack_entry == NULL)
+    {
+        for (int i = 0; i < NUMBER_OF_SPRITES; i++) { asset_loader.Queue(i, SPRITE_PATHS[i]); }
+        asset_loader.Start();
+    }
+    for (int i = 0; i < NUMBER_OF_WIN_SCREENS; i++) { win_images[i].SetPath(i, WIN_SCREEN_PATHS[i]); }
 }
 
-// RESET
-void reset(glm::mat4 &model_matrix, const glm::vec3 init_position)
+// MAP ATLAS
+// Points the atlas at the pack, UV rects and all
+void map_atlas()
 {
-    // Reset model matrix
-    model_matrix  = glm::mat4(1.0f);
-    // Translate to initial position
-    model_matrix  = glm::translate(model_matrix, init_position);
+    const AssetPackRect* rects = asset_pack.Rects(*atlas_pack_entry);
+    for (int i = 0; i < NUMBER_OF_SPRITES; i++)
+    {
+        UvRect uv = { rects[i].u0, rects[i].v0, rects[i].u1, rects[i].v1 };
+        sprite_uvs[i] = uv;
+    }
+    atlas_pixels = asset_pack.Pixels(*atlas_pack_entry);
+    atlas_width = atlas_pack_entry->width;
+    atlas_height = atlas_pack_entry->height;
+    LOG_INFO("Sprite atlas " << atlas_width << "x" << atlas_height << " mapped from " << ASSET_PACK_PATH);
 }
 
-// Checks whether objects hit the upper and lower walls
-bool is_out_of_bound(const glm::vec3 &init_position, glm::vec3 &position,
-                     const glm::vec3 scale_vector)
+// DECODE ATLAS
+// Collects the decoded sprites and packs them into one sheet
+bool decode_atlas()
 {
-    float window_height = 3.75f;
-    float boundary_limit = window_height - 0.5f * scale_vector.y;
-    glm::vec3 curr_position = init_position + position;
-    if (curr_position.y <= -boundary_limit or curr_position.y >= boundary_limit)
-    { return true; }
-    else { return false; }
-}
+    std::vector<LoadedImage> loaded_images(NUMBER_OF_SPRITES);
+    std::vector<AtlasImage> images(NUMBER_OF_SPRITES);
+    bool loaded = true;
+    LoadedImage image;
+    while (asset_loader.Next(image))
+    {
+        if (image.pixels == NULL)
+        {
+            LOG_ERROR("Unable to load image " << image.path << ". Make sure the path is correct.");
+            loaded = false;
+        }
+        loaded_images[image.id] = image;
+        AtlasImage atlas_image = { image.width, image.height, image.pixels };
+        images[image.id] = atlas_image;
+    }
+    asset_loader.Stop();
+    LOG_INFO("Decoded " << NUMBER_OF_SPRITES << " sprites on " << asset_loader.threads << " threads in "
+             << asset_loader.wall_seconds * 1000.0 << " ms, slowest " << asset_loader.slowest_seconds * 1000.0
+             << " ms, " << asset_loader.decode_seconds * 1000.0 << " ms decoding in all");
 
-// Checks whether ball hits left or right wall
-bool ball_hits_vertical_wall(const glm::vec3 &init_position, glm::vec3 &position)
-{
-    float window_width = 5.0f;
-    float boundary_limit = window_width - 0.5f * SIZE_BALL.x;
-    glm::vec3 curr_position = init_position + position;
-    if (curr_position.x <= -boundary_limit or curr_position.x >= boundary_limit)
-    { return true; }
-    else { return false; }
+    AtlasLayout &layout = atlas_layout;
+    if (loaded and !pack_atlas(images, layout))
+    {
+        LOG_ERROR("Sprites do not fit in a " << ATLAS_MAX_SIZE << "x" << ATLAS_MAX_SIZE << " atlas");
+        loaded = false;
+    }
+    for (int i = 0; i < NUMBER_OF_SPRITES; i++)
+    {
+        free_image(loaded_images[i]);
+    }
+    if (!loaded) { return false; }
+
+    for (int i = 0; i < NUMBER_OF_SPRITES; i++)
+    {
+        const AtlasRect &rect = layout.rects[i];
+        UvRect uv = { rect.u0, rect.v0, rect.u1, rect.v1 };
+        sprite_uvs[i] = uv;
+    }
+    atlas_pixels = layout.pixels.data();
+    atlas_width = layout.width;
+    atlas_height = layout.height;
+    LOG_INFO("Sprite atlas " << layout.width << "x" << layout.height);
+    return true;
 }
 
-// Move paddles according to user input and takes care of out-of-bound stuff
-void user_move_object(const glm::vec3 &init_position, glm::vec3 &position,
-                 const glm::vec3 scale_vector, glm::vec3 &movement,
-                 const float speed, glm::mat4 &model_matrix, float delta_time)
+// LOAD ATLAS
+// From the pack when it is there and current, else from the PNGs. Only
+// uploaded when drawing with GL.
+bool load_atlas()
 {
-    // Set new position
-    position += movement * speed * delta_time;
-    // If out-of-bound, do not let add to position
-    if (is_out_of_bound(init_position, position, scale_vector))
+    TRACE_ZONE("load_atlas");
+    if (atlas_pack_entry != NULL) { map_atlas(); }
+    else if (!decode_atlas()) { return false; }
+
+    if (!software_rendering)
     {
-        position -= movement * speed * delta_time;
+        texture_id_atlas = create_texture(atlas_pixels, atlas_width, atlas_height);
     }
-    // Translate to new position
-    model_matrix = glm::translate(model_matrix, position);
-    // Reset movement vector
-    movement = glm::vec3(0.0f, 0.0f, 0.0f);
-    
+    return true;
 }
 
-// Detects collision
-bool collided(glm::vec3 &position_a, glm::vec3 &position_b,
-              const glm::vec3 &init_position_a, const glm::vec3 &init_position_b,
-              const glm::vec3 &size_vec_a, const glm::vec3 &size_vec_b)
+// INITIALISE OBJECTS
+void init_objects(std::shared_ptr<ShaderProgram> &program,
+                  glm::mat4 &view_matrix, glm::mat4 &projection_matrix)
 {
-    // Collision factor
-    float collision_factor = 1.0f;
-    // Get current position
-    glm::vec3 curr_position_a = init_position_a + position_a;
-    glm::vec3 curr_position_b = init_position_b + position_b;
-    // Get x_ and y_distances
-    float x_distance = fabs(curr_position_a.x - curr_position_b.x) - (collision_factor * (size_vec_a.x + size_vec_b.x) / 2.0f);
-    float y_distance = fabs(curr_position_a.y - curr_position_b.y) - (collision_factor * (size_vec_a.y + size_vec_b.y) / 2.0f);
-
-    if (x_distance < 0 && y_distance < 0)
-    { return true; }
-    else { return false; }
-}
+    TRACE_ZONE("init_objects");
+    // Load up shaders, compiled only the first time
+    program = shader_cache.Load(V_SHADER_PATH, F_SHADER_PATH);
 
+    // Set matrices
+    program->SetProjectionMatrix(projection_matrix);
+    program->SetViewMatrix(view_matrix);
+    // The sprite batch places the quads itself
+    program->SetModelMatrix(glm::mat4(1.0f));
 
-// INITIALISE
-void initialise()
+    // Object ID
+    gl_state().UseProgram(program->programID);
+}
+
+// ENABLE SHADER BINARIES
+void enable_shader_binaries()
 {
+    std::string directory = shader_cache_directory != NULL ? shader_cache_directory : "";
+    if (directory.empty())
+    {
+        char* preferences = SDL_GetPrefPath("Pokepong", "Pokepong");
+        if (preferences == NULL)
+        {
+            LOG_WARN("No preference directory for shader binaries, compiling every launch");
+            return;
+        }
+        directory = preferences;
+        SDL_free(preferences);
+    }
+    if (shader_cache.SetBinaryDirectory(directory)) { LOG_INFO("Shader binaries kept in " << directory); }
+    else { LOG_INFO("No program binary formats, compiling shaders every launch"); }
+}
 
-    SDL_Init(SDL_INIT_VIDEO);
+// INITIALISE GL
+void initialise_gl()
+{
+    if (!legacy_gl)
+    {
+        // Ask for 3.3 core, which is also the only way past 2.1 on macOS
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, CORE_GL_MAJOR);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, CORE_GL_MINOR);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG);
+    }
     display_window = SDL_CreateWindow("Pokepong",
                                       SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
                                       WINDOW_WIDTH, WINDOW_HEIGHT,
                                       SDL_WINDOW_OPENGL);
     
     SDL_GLContext context = SDL_GL_CreateContext(display_window);
+    if (context == NULL and !legacy_gl)
+    {
+        LOG_WARN("No GL " << CORE_GL_MAJOR << "." << CORE_GL_MINOR << " core context, falling back to legacy GL");
+        legacy_gl = true;
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, 0);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
+        context = SDL_GL_CreateContext(display_window);
+    }
     SDL_GL_MakeCurrent(display_window, context);
     
 #ifdef _WINDOWS
+    glewExperimental = GL_TRUE;
     glewInit();
 #endif
+    ShaderProgram::coreProfile = !legacy_gl;
+    LOG_INFO("GL " << (const char*) glGetString(GL_VERSION) << (legacy_gl ? "" : " core"));
+    if (use_shader_cache) { enable_shader_binaries(); }
     
     // Initialise camera
     glViewport(VIEWPORT_X, VIEWPORT_Y, VIEWPORT_WIDTH, VIEWPORT_HEIGHT);
+}
+
+// INITIALISE GL OBJECTS
+void initialise_gl_objects()
+{
+    init_objects(program_left_pad, g_view_matrix, g_projection_matrix);
+
+    init_objects(program_right_pad, g_view_matrix, g_projection_matrix);
+
+    init_objects(program_ball, g_view_matrix, g_projection_matrix);
+    
+    init_objects(program_line, g_view_matrix, g_projection_matrix);
+    
+    init_objects(program_p1, g_view_matrix, g_projection_matrix);
     
+    init_objects(program_p2, g_view_matrix, g_projection_matrix);
+    
+    LOG_INFO("Shader programs: " << shader_cache.compiles << " compiled in " << shader_cache.compile_seconds * 1000.0
+             << " ms, " << shader_cache.binary_hits << " restored in " << shader_cache.restore_seconds * 1000.0
+             << " ms, " << shader_cache.hits << " reused; binaries " << shader_cache.binary_misses << " missing, "
+             << shader_cache.binary_rejects << " rejected");
+
+    // Enable blending
+    gl_state().SetBlend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glClearColor(BG_RED, BG_GREEN, BG_BLUE, BG_OPACITY);
+
+    sprite_batch.Initialise(SPRITE_BATCH_CAPACITY, stream_strategy);
+    LOG_INFO("Sprites drawn " << (sprite_batch.instanced ? "instanced" : "as indexed quads") << ", streamed "
+             << stream_strategy_name(sprite_batch.stream.strategy));
+}
+
+// INITIALISE SOFTWARE
+void initialise_software()
+{
+    display_window = SDL_CreateWindow("Pokepong",
+                                      SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+                                      WINDOW_WIDTH, WINDOW_HEIGHT,
+                                      SDL_WINDOW_SHOWN);
+    // With no display (SDL_VIDEODRIVER=dummy) frames only reach --screenshot
+    if (display_window == NULL or SDL_GetWindowSurface(display_window) == NULL)
+    {
+        LOG_WARN("No window surface, rendering offscreen");
+    }
+    software_renderer.Initialise(WINDOW_WIDTH, WINDOW_HEIGHT);
+    software_renderer.SetViewProjection(g_projection_matrix * g_view_matrix);
+    software_renderer.SetClearColor(BG_RED, BG_GREEN, BG_BLUE, BG_OPACITY);
+    software_texture_atlas = software_renderer.AddTexture(atlas_pixels, atlas_width, atlas_height);
+    LOG_INFO("Software rendering, " << simd_level_name(software_renderer.simd_level) << " spans");
+}
+
+// INITIALISE
+void initialise()
+{
+    TRACE_ZONE("initialise");
+
+    // Decoding overlaps creating the window and context
+    start_asset_loading();
+    SDL_Init(SDL_INIT_VIDEO);
+    if (!software_rendering) { initialise_gl(); }
+
     // Initialise view and projection matrices
     g_view_matrix       = glm::mat4(1.0f);
     
     g_projection_matrix = glm::ortho(-5.0f, 5.0f, -3.75f, 3.75f, -1.0f, 1.0f);
     
     // Initialise objects
-    init_objects(program_left_pad, texture_id_left_pad, SPRITE_LEFT_PADDLE,
-                 model_matrix_left_pad, g_view_matrix, g_projection_matrix,
-                 INIT_POSITION_LEFT_PAD, SIZE_PADDLE);
+    if (!load_atlas())
+    {
+        game_is_running = false;
+    }
 
-    init_objects(program_right_pad, texture_id_right_pad, SPRITE_RIGHT_PADDLE,
-                 model_matrix_right_pad, g_view_matrix, g_projection_matrix,
-                 INIT_POSITION_RIGHT_PAD, SIZE_PADDLE);
+    if (software_rendering) { initialise_software(); }
+    else { initialise_gl_objects(); }
 
-    init_objects(program_ball, texture_id_ball, SPRITE_BALL,
-                 model_matrix_ball, g_view_matrix, g_projection_matrix,
-                 INIT_POSITION_BALL, SIZE_BALL);
-    
-    init_objects(program_line, texture_id_line, SPRITE_LINE,
-                 model_matrix_line, g_view_matrix, g_projection_matrix,
-                 INIT_POSITION_LINE, SIZE_LINE);
-    
-    init_objects(program_p1, texture_id_p1, SPRITE_P1,
-                 model_matrix_p1, g_view_matrix, g_projection_matrix,
-                 INIT_POSITION_P1, SIZE_PLAYER);
-    
-    init_objects(program_p2, texture_id_p2, SPRITE_P2,
-                 model_matrix_p2, g_view_matrix, g_projection_matrix,
-                 INIT_POSITION_P2, SIZE_PLAYER);
-    
-    init_objects(program_p1_win, texture_id_p1_win, SPRITE_P1_WIN,
-                 model_matrix_p1_win, g_view_matrix, g_projection_matrix,
-                 INIT_POSITION_P1_WIN, SIZE_WIN);
-    
-    init_objects(program_p2_win, texture_id_p2_win, SPRITE_P2_WIN,
-                 model_matrix_p2_win, g_view_matrix, g_projection_matrix,
-                 INIT_POSITION_P2_WIN, SIZE_WIN);
-    // Enable blending
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    reset_match(match);
+    previous_match = match;
+    game_clock.Start();
+    frame_pacer.Start(target_fps);
+}
 
-    glClearColor(BG_RED, BG_GREEN, BG_BLUE, BG_OPACITY);
+
+// Draw calls and GL state changes of the last frame
+void print_batch_stats()
+{
+    if (software_rendering)
+    {
+        LOG("Software frames: " << software_renderer.frames << ", sprites " << software_renderer.sprites_drawn
+            << ", " << simd_level_name(software_renderer.simd_level) << " spans");
+        return;
+    }
+    const SpriteBatchStats &stats = sprite_batch.frame_stats;
+    LOG("Sprites: " << stats.sprites << ", draw calls " << stats.draw_calls << ", program binds "
+        << stats.program_binds << ", texture binds " << stats.texture_binds << ", attribute setups "
+        << stats.attribute_setups << ", buffer uploads " << stats.buffer_uploads);
+    // Calls the state cache kept from reaching GL since startup
+    gl_state().Print();
 }
 
 
@@ -362,6 +571,16 @@ void process_input()
                     case SDLK_q:
                         game_is_running = !game_is_running;
                         break;
+
+                    case SDLK_p:
+                        game_clock.SetPaused(!game_clock.IsPaused());
+                        break;
+
+                    case SDLK_F1:
+                        print_batch_stats();
+                        frame_stats.Print();
+                        frame_stats.WriteJson(stats_path);
+                        break;
                         
                     default: break;
                 }
@@ -401,194 +620,386 @@ void process_input()
 
 }
 
+// PREFETCH WIN SCREEN
+// Starts decoding the win screen for the goal the ball is closing on
+void prefetch_win_screen(const MatchState &state)
+{
+    float ball_x = INIT_POSITION_BALL.x + state.position_ball.x;
+    if (state.movement_ball.x < 0.0f and ball_x < WIN_PREFETCH_DISTANCE - FIELD_HALF_WIDTH)
+    {
+        // Out on the left means player 2 wins, packed ones need no decode
+        if (win_pack_entries[WIN_SCREEN_P2] == NULL) { win_images[WIN_SCREEN_P2].Prefetch(); }
+    }
+    else if (state.movement_ball.x > 0.0f and ball_x > FIELD_HALF_WIDTH - WIN_PREFETCH_DISTANCE)
+    {
+        if (win_pack_entries[WIN_SCREEN_P1] == NULL) { win_images[WIN_SCREEN_P1].Prefetch(); }
+    }
+}
+
 // UPDATE
 void update()
 {
-    // Counting ticks
-    float ticks = (float) SDL_GetTicks() / 1000.0f;
-    float delta_time = ticks - previous_ticks;
-    previous_ticks = ticks;
-    
-    // Reset model matrix
-    reset(model_matrix_left_pad, INIT_POSITION_LEFT_PAD);
-    reset(model_matrix_right_pad, INIT_POSITION_RIGHT_PAD);
-    reset(model_matrix_ball, INIT_POSITION_BALL);
-    
-    // Paddles movement according to user input
-    user_move_object(INIT_POSITION_LEFT_PAD, position_left_pad, SIZE_PADDLE, movement_left_pad,
-                SPEED_PAD, model_matrix_left_pad, delta_time);
-    user_move_object(INIT_POSITION_RIGHT_PAD, position_right_pad, SIZE_PADDLE, movement_right_pad,
-                SPEED_PAD, model_matrix_right_pad, delta_time);
-    
-    // Ball movement
-    // Set new position
-    position_ball += movement_ball * SPEED_BALL * delta_time;
-    // If ball hits vertical wall, end game
-    if (ball_hits_vertical_wall(INIT_POSITION_BALL, position_ball))
+    // Counting ticks, 0 while paused
+    double delta_time = game_clock.Tick();
+
+    // Advance the match in fixed steps with this frame's paddle input
+    MatchInput input = { movement_left_pad.y, movement_right_pad.y };
+    accumulator += delta_time;
+    while (accumulator >= fixed_delta_time and !match.end_game)
     {
-        LOG("SCORE!");
-        end_game = true;
-        winner = (INIT_POSITION_BALL + position_ball).x < 0 ? 2 : 1;
+        previous_match = match;
+        step(match, input, fixed_delta_time);
+        accumulator -= fixed_delta_time;
     }
-    // If ball collides with any paddle
-    else
+    if (!match.end_game) { prefetch_win_screen(match); }
+    // Reset movement vectors
+    movement_left_pad = glm::vec3(0.0f, 0.0f, 0.0f);
+    movement_right_pad = glm::vec3(0.0f, 0.0f, 0.0f);
+
+    if (match.end_game)
     {
-        if (collided(position_ball, position_left_pad, INIT_POSITION_BALL,
-                      INIT_POSITION_LEFT_PAD, SIZE_BALL, SIZE_PADDLE) or
-             collided(position_ball, position_right_pad, INIT_POSITION_BALL,
-                      INIT_POSITION_RIGHT_PAD, SIZE_BALL, SIZE_PADDLE))
-        {
-            position_ball -= movement_ball * SPEED_BALL * delta_time;
-            movement_ball = glm::vec3(-movement_ball.x, movement_ball.y, 0.0f);
-            position_ball += movement_ball * SPEED_BALL * delta_time;
-        }
-        else if (is_out_of_bound(INIT_POSITION_BALL, position_ball, SIZE_BALL))
-        {
-            position_ball -= movement_ball * SPEED_BALL * delta_time;
-            movement_ball = glm::vec3(movement_ball.x, -movement_ball.y, 0.0f);
-            position_ball += movement_ball * SPEED_BALL * delta_time;
-        }
+        LOG_INFO_EVERY(1.0, "SCORE!");
+        end_game = true;
+        winner = match.winner;
+    }
+}
 
-        model_matrix_ball = glm::translate(model_matrix_ball, position_ball);
+
+
+// DRAW SPRITE
+// Queues a sprite with whichever renderer is active
+void draw_sprite(const std::shared_ptr<ShaderProgram> &program, SpriteId id, SpriteLayer layer,
+                 const glm::vec3 &position, const glm::vec3 &size, float rotation = 0.0f)
+{
+    if (software_rendering)
+    {
+        software_renderer.Draw(software_texture_atlas, layer, position, size, sprite_uvs[id], rotation);
     }
+    else { sprite_batch.Draw(*program, texture_id_atlas, layer, position, size, sprite_uvs[id], rotation); }
+}
 
-    // Rotate ball
-    rot_angle += ROT_SPEED_BALL * delta_time;
-    model_matrix_ball = glm::rotate(model_matrix_ball, glm::radians(rot_angle), glm::vec3(0.0f, 0.0f, 1.0f));
-    
-    // Scale objects back
-    model_matrix_left_pad = glm::scale(model_matrix_left_pad, SIZE_PADDLE);
-    model_matrix_right_pad = glm::scale(model_matrix_right_pad, SIZE_PADDLE);
-    model_matrix_ball = glm::scale(model_matrix_ball, SIZE_BALL);
+// MAKE RESIDENT
+// Uploads a win screen the first time it is drawn, straight from the pack
+// when it has the screen, and frees any decoded pixels
+bool make_resident(WinScreen screen, std::shared_ptr<ShaderProgram> &program)
+{
+    if (win_resident[screen]) { return true; }
+    if (win_failed[screen]) { return false; }
+    TRACE_ZONE("make_resident");
+    LazyImage &lazy = win_images[screen];
+    const AssetPackEntry* entry = win_pack_entries[screen];
+    bool prefetched = lazy.Requested();
+    LoadedImage image = { screen, WIN_SCREEN_PATHS[screen], 0, 0, NULL, 0.0 };
+    if (entry != NULL)
+    {
+        image.width = entry->width;
+        image.height = entry->height;
+        image.pixels = (unsigned char*) asset_pack.Pixels(*entry);
+    }
+    else { image = lazy.Get(); }
+    if (image.pixels == NULL)
+    {
+        LOG_ERROR("Unable to load image " << image.path << ". Make sure the path is correct.");
+        win_failed[screen] = true;
+        return false;
+    }
+    if (software_rendering)
+    {
+        win_software_textures[screen] = software_renderer.AddTexture(image.pixels, image.width, image.height);
+    }
+    else
+    {
+        win_textures[screen] = create_texture(image.pixels, image.width, image.height);
+        init_objects(program, g_view_matrix, g_projection_matrix);
+    }
+    if (entry != NULL) { LOG_INFO("Win screen " << image.path << " mapped from " << ASSET_PACK_PATH); }
+    else
+    {
+        LOG_INFO("Win screen " << image.path << (prefetched ? " prefetched" : " loaded on first use")
+                 << ", waited " << lazy.wait_seconds * 1000.0 << " ms");
+        lazy.Release();
+    }
+    win_resident[screen] = true;
+    return true;
 }
 
+// DRAW WIN SCREEN
+void draw_win_screen(std::shared_ptr<ShaderProgram> &program, WinScreen screen, const glm::vec3 &position)
+{
+    if (!make_resident(screen, program)) { return; }
+    if (software_rendering)
+    {
+        software_renderer.Draw(win_software_textures[screen], LAYER_BACKGROUND, position, SIZE_WIN);
+    }
+    else { sprite_batch.Draw(*program, win_textures[screen], LAYER_BACKGROUND, position, SIZE_WIN); }
+}
 
 // RENDER
 void render()
+{
+    // Draw where the match is between the last two fixed steps
+    float alpha = match.end_game ? 1.0f : (float) (accumulator / fixed_delta_time);
+    MatchState state = interpolate_match(previous_match, match, alpha);
+
+    if (software_rendering) { software_renderer.Begin(); }
+    else
     {
-    glClear(GL_COLOR_BUFFER_BIT);
+        glClear(GL_COLOR_BUFFER_BIT);
+        sprite_batch.Begin();
+    }
     // Show the winner
     if (end_game)
     {
         if (winner == 1)
         {
             // Player 1 wins
-            float vertices_p1_win[] = {
-                -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-                -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f
-            };
-            float texture_coordinates_p1_win[] = {
-                0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-                0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-            };
-            draw_object(program_p1_win, model_matrix_p1_win, texture_id_p1_win,
-                        vertices_p1_win, texture_coordinates_p1_win);
+            draw_win_screen(program_p1_win, WIN_SCREEN_P1, INIT_POSITION_P1_WIN);
         }
         else
         {
             // Player 2 wins
-            float vertices_p2_win[] = {
-                -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-                -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f
-            };
-            float texture_coordinates_p2_win[] = {
-                0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-                0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-            };
-            draw_object(program_p2_win, model_matrix_p2_win, texture_id_p2_win,
-                        vertices_p2_win, texture_coordinates_p2_win);
+            draw_win_screen(program_p2_win, WIN_SCREEN_P2, INIT_POSITION_P2_WIN);
         }
     }
-    // Line
-    float vertices_line[] = {
-        -0.05f, -3.75f, 0.05f, -3.75f, 0.05f, 3.75f,
-        -0.05f, -3.75f, 0.05f, 3.75f, -0.05f, 3.75f
-    };
-    float texture_coordinates_line[] = {
-        0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-    };
-    draw_object(program_line, model_matrix_line, texture_id_line,
-                vertices_line, texture_coordinates_line);
-    
-    // Player 1
-    float vertices_p1[] = {
-        -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-        -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f
-    };
-    float texture_coordinates_p1[] = {
-        0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-    };
-    draw_object(program_p1, model_matrix_p1, texture_id_p1,
-                vertices_p1, texture_coordinates_p1);
-    
-    // Player 2
-    float vertices_p2[] = {
-        -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-        -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f
-    };
-    float texture_coordinates_p2[] = {
-        0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-    };
-    draw_object(program_p2, model_matrix_p2, texture_id_p2,
-                vertices_p2, texture_coordinates_p2);
-    
-    // Left paddle
-    float vertices_left_pad[] = {
-        -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-        -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f
-    };
-    float texture_coordinates_left_pad[] = {
-        0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-    };
-    draw_object(program_left_pad, model_matrix_left_pad, texture_id_left_pad,
-                vertices_left_pad, texture_coordinates_left_pad);
-    
-    // Right paddle
-    float vertices_right_pad[] = {
-        -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-        -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f
-    };
-    float texture_coordinates_right_pad[] = {
-        0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-    };
-    draw_object(program_right_pad, model_matrix_right_pad, texture_id_right_pad,
-                vertices_right_pad, texture_coordinates_right_pad);
-    
-    // Ball
-    float vertices_right_ball[] = {
-        -0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f,
-        -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f
-    };
-    float texture_coordinates_ball[] = {
-        0.0f, 1.0f, 1.0f, 1.0f, 1.0f, 0.0f,
-        0.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f,
-    };
-    draw_object(program_ball, model_matrix_ball, texture_id_ball,
-                vertices_right_ball, texture_coordinates_ball);
-    
-    SDL_GL_SwapWindow(display_window);
+    // Line and players
+    draw_sprite(program_line, SPRITE_ID_LINE, LAYER_FIELD, INIT_POSITION_LINE, SIZE_LINE);
+    draw_sprite(program_p1, SPRITE_ID_P1, LAYER_FIELD, INIT_POSITION_P1, SIZE_PLAYER);
+    draw_sprite(program_p2, SPRITE_ID_P2, LAYER_FIELD, INIT_POSITION_P2, SIZE_PLAYER);
+
+    // Paddles and ball
+    draw_sprite(program_left_pad, SPRITE_ID_LEFT_PADDLE, LAYER_PADDLES,
+                INIT_POSITION_LEFT_PAD + state.position_left_pad, SIZE_PADDLE);
+    draw_sprite(program_right_pad, SPRITE_ID_RIGHT_PADDLE, LAYER_PADDLES,
+                INIT_POSITION_RIGHT_PAD + state.position_right_pad, SIZE_PADDLE);
+    draw_sprite(program_ball, SPRITE_ID_BALL, LAYER_BALL,
+                INIT_POSITION_BALL + state.position_ball, SIZE_BALL, state.rot_angle);
+    if (software_rendering) { software_renderer.End(); }
+    else { sprite_batch.End(); }
 }
 
+// PRESENT
+// Only the swap itself counts as swap time, the copies are CPU work
+void present()
+{
+    if (!software_rendering)
+    {
+        {
+            PhaseTimer timer(frame_stats, PHASE_PRESENT);
+            TRACE_ZONE("capture");
+            frame_capture.CaptureGL();
+        }
+        PhaseTimer timer(frame_stats, PHASE_SWAP);
+        TRACE_ZONE("swap");
+        SDL_GL_SwapWindow(display_window);
+        return;
+    }
+    PhaseTimer timer(frame_stats, PHASE_PRESENT);
+    TRACE_ZONE("blit");
+    frame_capture.CapturePixels(software_renderer.Pixels());
+    SDL_Surface *window_surface = display_window != NULL ? SDL_GetWindowSurface(display_window) : NULL;
+    if (window_surface == NULL) { return; }
+    SDL_Surface *frame = SDL_CreateRGBSurfaceWithFormatFrom((void*) software_renderer.Pixels(),
+                                                            software_renderer.width, software_renderer.height, 32,
+                                                            software_renderer.width * 4, SDL_PIXELFORMAT_RGBA32);
+    SDL_BlitSurface(frame, NULL, window_surface, NULL);
+    SDL_FreeSurface(frame);
+    SDL_UpdateWindowSurface(display_window);
+}
+
+// SAVE SCREENSHOT
+void save_screenshot(const char* path)
+{
+    bool written;
+    if (software_rendering)
+    {
+        written = write_ppm(path, software_renderer.Pixels(), software_renderer.width, software_renderer.height);
+    }
+    else
+    {
+        // The back buffer still holds the last frame drawn
+        std::vector<uint32_t> pixels((size_t) WINDOW_WIDTH * WINDOW_HEIGHT);
+        glReadPixels(0, 0, WINDOW_WIDTH, WINDOW_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+        written = write_ppm(path, pixels.data(), WINDOW_WIDTH, WINDOW_HEIGHT, true);
+    }
+    if (written) { LOG("Screenshot written to " << path); }
+    else { LOG_ERROR("Unable to write screenshot to " << path); }
+}
+
+// BENCH STREAM
+// Streams STREAM_BENCH_SPRITES spinning balls a frame through each strategy
+void bench_stream(int frames)
+{
+    // Unthrottled, so the numbers are the upload path and not vsync
+    SDL_GL_SetSwapInterval(0);
+    sprite_batch.Cleanup();
+    for (int s = 0; s < STREAM_STRATEGIES; s++)
+    {
+        StreamStrategy strategy = (StreamStrategy) s;
+        sprite_batch.Initialise(STREAM_BENCH_SPRITES, strategy);
+        if (sprite_batch.stream.strategy != strategy)
+        {
+            LOG("Stream " << stream_strategy_name(strategy) << ": unsupported");
+            sprite_batch.Cleanup();
+            continue;
+        }
+
+        glFinish();
+        uint64_t start = clock_counter();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            glClear(GL_COLOR_BUFFER_BIT);
+            sprite_batch.Begin();
+            for (size_t i = 0; i < STREAM_BENCH_SPRITES; i++)
+            {
+                float angle = frame * 0.02f + i * 0.37f;
+                glm::vec3 position(4.5f * cosf(angle * 1.3f), 3.25f * sinf(angle), 0.0f);
+                sprite_batch.Draw(*program_ball, texture_id_atlas, LAYER_BALL, position, STREAM_BENCH_SIZE,
+                                  sprite_uvs[SPRITE_ID_BALL], angle * 57.3f);
+            }
+            sprite_batch.End();
+            SDL_GL_SwapWindow(display_window);
+        }
+        glFinish();
+        double seconds = (double) (clock_counter() - start) / clock_frequency();
+
+        const StreamBuffer &stream = sprite_batch.stream;
+        LOG("Stream " << stream_strategy_name(strategy) << ": " << seconds * 1000.0 / frames << " ms/frame, "
+            << stream.writes << " writes of " << stream.frame_bytes / 1024 << " KiB, fence waits "
+            << stream.fence_waits << " (" << stream.fence_wait_seconds * 1000.0 << " ms)");
+        sprite_batch.Cleanup();
+    }
+    sprite_batch.Initialise(SPRITE_BATCH_CAPACITY, stream_strategy);
+}
 
 // SHUTDOWN
-void shutdown() { SDL_Quit(); }
+void shutdown()
+{
+    // Time the loop gave back instead of burning a core
+    LOG("Frames: " << frame_pacer.frames << " in " << frame_pacer.WallSeconds() << " s, CPU "
+        << frame_pacer.CpuSeconds() << " s");
+    LOG("Saved: slept " << frame_pacer.slept_seconds << " s, idle " << frame_pacer.waited_seconds
+        << " s over " << frame_pacer.idle_waits << " waits, spun " << frame_pacer.spun_seconds << " s");
+    print_batch_stats();
+    frame_stats.Print();
+    frame_stats.WriteJson(stats_path);
+#ifdef POKEPONG_TRACE
+    if (trace_write_json(trace_path)) { LOG("Trace written to " << trace_path); }
+    else { LOG_ERROR("Unable to write trace to " << trace_path); }
+#endif
+    if (log_dropped() > 0) { LOG_WARN("Log lines dropped: " << log_dropped()); }
+    if (screenshot_path != NULL) { save_screenshot(screenshot_path); }
+    frame_capture.Stop();
+
+    // The last reference deletes the shared program while the context lives
+    program_left_pad.reset(); program_right_pad.reset();
+    program_ball.reset(); program_line.reset();
+    program_p1.reset(); program_p2.reset();
+    program_p1_win.reset(); program_p2_win.reset();
+    if (software_rendering) { software_renderer.Cleanup(); }
+    else { sprite_batch.Cleanup(); }
+    asset_pack.Close();
+
+    log_stop();
+    SDL_Quit();
+}
 
 
 int main(int argc, char* argv[])
 {
+    // --tick-rate hz sets the fixed simulation rate, --fps the frame cap,
+    // --stats-json where the frame timings go, --trace the zone trace,
+    // --stream persistent, orphan or subdata how sprites are uploaded,
+    // --legacy-gl keeps to the 2.1 context, --bench-stream times each
+    // upload strategy and quits, --software draws on the CPU,
+    // --screenshot path saves the last frame, --capture path records
+    // every frame to path if it ends in .y4m, else to path_00000.png on,
+    // --shader-cache dir keeps linked shader binaries there and
+    // --no-shader-cache compiles them every launch
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        if (strcmp(argv[i], "--tick-rate") == 0 and atof(argv[i + 1]) > 0.0)
+        {
+            fixed_delta_time = 1.0f / (float) atof(argv[i + 1]);
+        }
+        if (strcmp(argv[i], "--fps") == 0) { target_fps = atof(argv[i + 1]); }
+        if (strcmp(argv[i], "--stats-json") == 0) { stats_path = argv[i + 1]; }
+        if (strcmp(argv[i], "--trace") == 0) { trace_path = argv[i + 1]; }
+        if (strcmp(argv[i], "--screenshot") == 0) { screenshot_path = argv[i + 1]; }
+        if (strcmp(argv[i], "--capture") == 0) { capture_path = argv[i + 1]; }
+        if (strcmp(argv[i], "--shader-cache") == 0) { shader_cache_directory = argv[i + 1]; }
+        for (int s = 0; s < STREAM_STRATEGIES; s++)
+        {
+            if (strcmp(argv[i], "--stream") == 0 and strcmp(argv[i + 1], stream_strategy_name((StreamStrategy) s)) == 0)
+            {
+                stream_strategy = (StreamStrategy) s;
+            }
+        }
+    }
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--legacy-gl") == 0) { legacy_gl = true; }
+        if (strcmp(argv[i], "--software") == 0) { software_rendering = true; }
+        if (strcmp(argv[i], "--no-shader-cache") == 0) { use_shader_cache = false; }
+        if (strcmp(argv[i], "--bench-stream") == 0)
+        {
+            stream_bench_frames = i + 1 < argc and atoi(argv[i + 1]) > 0 ? atoi(argv[i + 1])
+                                                                        : DEFAULT_STREAM_BENCH_FRAMES;
+        }
+    }
+
+    // Log lines are written by a background thread from here on
+    log_start();
+#ifdef POKEPONG_TRACE
+    trace_set_thread_name("main");
+#endif
     initialise();
+    if (stream_bench_frames > 0)
+    {
+        if (software_rendering) { LOG_WARN("--bench-stream needs GL, ignored with --software"); }
+        else { bench_stream(stream_bench_frames); }
+        game_is_running = false;
+    }
+    if (capture_path != NULL and game_is_running)
+    {
+        int capture_fps = target_fps > 0.0 ? (int) (target_fps + 0.5) : DEFAULT_CAPTURE_FPS;
+        if (!frame_capture.Start(capture_path, WINDOW_WIDTH, WINDOW_HEIGHT, capture_fps, !software_rendering))
+        {
+            game_is_running = false;
+        }
+    }
     
     while (game_is_running)
     {
-        LOG(end_game);
-        process_input();
-        if (end_game == false) { update(); }
-        render();
+        PhaseTimer frame_timer(frame_stats, PHASE_FRAME);
+        TRACE_ZONE("frame");
+        LOG_DEBUG_EVERY(1.0, "end_game " << end_game);
+        if (end_game or game_clock.IsPaused())
+        {
+            // Nothing moves on the winner screen or while paused, sleep
+            // until there is input
+            PhaseTimer timer(frame_stats, PHASE_IDLE);
+            frame_pacer.WaitForEvent(IDLE_WAIT_MS);
+        }
+        {
+            PhaseTimer timer(frame_stats, PHASE_INPUT);
+            process_input();
+        }
+        if (end_game == false)
+        {
+            PhaseTimer timer(frame_stats, PHASE_UPDATE);
+            TRACE_ZONE("update");
+            update();
+        }
+        {
+            PhaseTimer timer(frame_stats, PHASE_RENDER);
+            TRACE_ZONE("render");
+            render();
+        }
+        present();
+        {
+            PhaseTimer timer(frame_stats, PHASE_PACING);
+            frame_pacer.EndFrame();
+        }
     }
     
     shutdown();
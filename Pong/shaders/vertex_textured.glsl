@@ -1,15 +1,30 @@
-attribute vec4 position;
+// Corner of the unit quad and where it falls across the texture
+attribute vec2 position;
 attribute vec2 texCoord;
 
+// One sprite: centre and size, rotation in radians, atlas rect and tint.
+// Drawn instanced these advance once per sprite, otherwise every corner
+// carries a copy.
+attribute vec4 instanceTransform;
+attribute float instanceRotation;
+attribute vec4 instanceUv;
+attribute vec4 instanceTint;
+
 uniform mat4 modelMatrix;
 uniform mat4 viewMatrix;
 uniform mat4 projectionMatrix;
 
 varying vec2 texCoordVar;
+varying vec4 tintVar;
 
 void main()
 {
-	vec4 p = viewMatrix * modelMatrix  * position;
-    texCoordVar = texCoord;
+	float c = cos(instanceRotation);
+	float s = sin(instanceRotation);
+	vec2 scaled = position * instanceTransform.zw;
+	vec2 placed = vec2(c * scaled.x - s * scaled.y, s * scaled.x + c * scaled.y) + instanceTransform.xy;
+	vec4 p = viewMatrix * modelMatrix * vec4(placed, 0.0, 1.0);
+    texCoordVar = mix(instanceUv.xy, instanceUv.zw, texCoord);
+    tintVar = instanceTint;
 	gl_Position = projectionMatrix * p;
-}
\ No newline at end of file
+}